@@ -1,15 +1,36 @@
+import hashlib
 import os
+import struct
 import sys
 
-def binary_to_c_header(input_file):
+# DA config payload : integrity hash, public key hash, SoC mask (0x20 bytes each)
+OBK_HEADER_SIZE = 12
+SHA256_LENGTH = 32
+SOC_MASK_OFFSET = OBK_HEADER_SIZE + 2 * SHA256_LENGTH
+
+def set_soc_mask(data, soc_mask):
+    """Replace the SoC mask and recompute the integrity hash of the payload."""
+    mask = struct.pack("<I", soc_mask).ljust(SHA256_LENGTH, b"\x00")
+    payload = data[OBK_HEADER_SIZE + SHA256_LENGTH:SOC_MASK_OFFSET] + mask
+    return data[:OBK_HEADER_SIZE] + hashlib.sha256(payload).digest() + payload
+
+def binary_to_c_header(input_file, version=None, soc_mask=None):
     base_name = os.path.splitext(os.path.basename(input_file))[0]
 
     with open(input_file, 'rb') as f:
         data = f.read()
 
+    if soc_mask is not None:
+        # e.g. a mask limited to non secure permissions for a TZ-CLOSED device
+        data = set_soc_mask(data, soc_mask)
+        print(f"SoC mask set to 0x{soc_mask:08x}")
+
     output_file = f"{base_name}.h"
 
     with open(output_file, 'w') as f:
+        if version is not None:
+            # Monotonic version checked before rotating the provisioned DA record
+            f.write(f"#define DA_CONFIG_VERSION ({version}U)\n\n")
         f.write(f"const unsigned char {base_name}[] = {{\n")
         for i, byte in enumerate(data):
             if i % 16 == 0:
@@ -21,8 +42,13 @@ def binary_to_c_header(input_file):
 
 default_input_file = "DA_Config.obk"
 
+# Usage: ConvertBinToH.py [file.obk] [version] [soc_mask]
 if len(sys.argv) < 2:
     binary_to_c_header(default_input_file)
-else:
+elif len(sys.argv) < 3:
     binary_file_path = sys.argv[1]
-    binary_to_c_header(binary_file_path)
\ No newline at end of file
+    binary_to_c_header(binary_file_path)
+elif len(sys.argv) < 4:
+    binary_to_c_header(sys.argv[1], int(sys.argv[2], 0))
+else:
+    binary_to_c_header(sys.argv[1], int(sys.argv[2], 0), int(sys.argv[3], 0))
\ No newline at end of file
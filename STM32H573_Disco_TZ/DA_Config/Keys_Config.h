@@ -0,0 +1,26 @@
+/* Plain keys written by the "Provision keys" menu entry (K).
+
+   An image built with keys in this file is a provisioning image : it holds
+   the keys in clear in flash. Use it for the provisioning run only, then
+   build the product image with every count set to 0. The values below are
+   test patterns, replace them with the product keys. */
+#ifndef KEYS_CONFIG_H
+#define KEYS_CONFIG_H
+
+/* Key store GCM records : { ID, length in bytes, key words }, see key_store.h.
+   IDs with KEY_STORE_ID_NS (0x0080) set can be read by the non secure side. */
+#define KEYS_CONFIG_STORE_COUNT   (2U)
+#define KEYS_CONFIG_STORE \
+  { 0x0101U, 16U, { 0x16157E2BU, 0xA6D2AE28U, 0x8815F7ABU, 0x3C4FCF09U } }, \
+  { 0x0181U, 32U, { 0x10EB3D60U, 0xBE71CA15U, 0xF0AE732BU, 0x81777D85U, \
+                    0x072C351FU, 0xD708613BU, 0xA310982DU, 0xF4DF1409U } }
+
+/* OEM keys wrapped with the DHUK : { ID, OEM_KEY_USE_xxx, CRYP_KEYSIZE_xxx,
+   key words }, see oem_key.h. "obk_transport.py --key transport.key
+   --key-words" prints the entry of a transport key. */
+#define KEYS_CONFIG_OEM_COUNT     (1U)
+#define KEYS_CONFIG_OEM \
+  { 0x0200U, OEM_KEY_USE_AES, CRYP_KEYSIZE_256B, { 0x603DEB10U, 0x15CA71BEU, 0x2B73AEF0U, 0x857D7781U, \
+                                                   0x1F352C07U, 0x3B6108D7U, 0x2D9810A3U, 0x0914DFF4U } }
+
+#endif
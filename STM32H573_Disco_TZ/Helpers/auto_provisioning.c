@@ -0,0 +1,132 @@
+#include "auto_provisioning.h"
+#include "ob_config.h"
+#include "obk_provisioning.h"
+
+#define JOURNAL_MAGIC(j)          (((j) >> 24) & 0xFFU)
+#define JOURNAL_STEP(j)           (((j) >> 16) & 0xFFU)
+#define JOURNAL_ATTEMPTS(j)       (((j) >> 8) & 0xFFU)
+#define JOURNAL_RESETS(j)         (((j) >> 1) & 0x7FU)
+#define JOURNAL_FAILED(j)         ((j) & 0x1U)
+#define JOURNAL(step, attempts, resets, failed) \
+	((AUTOPROV_JOURNAL_MAGIC << 24) | ((step) << 16) | (((attempts) & 0xFFU) << 8) | (((resets) & 0x7FU) << 1) | (failed))
+
+static const char * const StepNames[] = { "TZEN", "WATERMARK", "CLOSE", "DA", "DONE" };
+
+static volatile uint32_t *Journal_Reg(void)
+{
+	return &TAMP_S->BKP0R + AUTOPROV_JOURNAL_INDEX;
+}
+
+/**
+  * @brief  Read the journal, a blank one when the magic is missing
+  * @retval Journal value
+  */
+static uint32_t Journal_Read(void)
+{
+	uint32_t journal;
+
+	/* Backup registers are clocked by the RTC APB clock, written once the
+	   backup domain protection is removed */
+	__HAL_RCC_RTC_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+
+	journal = *Journal_Reg();
+	if (JOURNAL_MAGIC(journal) != AUTOPROV_JOURNAL_MAGIC)
+	{
+		journal = JOURNAL(AUTOPROV_STEP_TZEN, 0U, 0U, 0U);
+	}
+	return journal;
+}
+
+static void Journal_Write(uint32_t journal)
+{
+	*Journal_Reg() = journal;
+	__DSB();
+}
+
+/**
+  * @brief  Run one step
+  * @note   A step either completes and returns 0, or resets the device after
+  *         an option byte launch or an OBK write. In that case it is entered
+  *         again after the reset and finds its change done.
+  * @param  Step AUTOPROV_STEP_xxx
+  * @retval PROV_OK if the step is complete, Prov_Status_t error otherwise
+  */
+static int32_t AutoProvisioning_Step(uint32_t Step)
+{
+	switch (Step)
+	{
+	case AUTOPROV_STEP_TZEN:
+		return OBConfig_Apply(OB_CONFIG_FIELD_TZEN);
+	case AUTOPROV_STEP_WATERMARK:
+		return OBConfig_Apply(OB_CONFIG_FIELD_WM);
+	case AUTOPROV_STEP_CLOSE:
+		return OBConfig_Apply(OB_CONFIG_FIELD_PROD);
+	case AUTOPROV_STEP_DA:
+		return OBKProvisioning_ProvisionDA();
+	default:
+		return PROV_OK;
+	}
+}
+
+/**
+  * @brief  Zero touch provisioning : TrustZone, watermarks, close, DA
+  * @note   Resumes at the step recorded in the journal, so the steps already
+  *         done are not checked again after each reset. The attempt count
+  *         of the step is journaled before running it, a step that keeps
+  *         resetting without completing is stopped. Ends with a one line
+  *         status.
+  * @retval PROV_OK when the device is provisioned, Prov_Status_t error otherwise
+  */
+int32_t AutoProvisioning_Run(void)
+{
+	uint32_t journal = Journal_Read();
+	uint32_t step = JOURNAL_STEP(journal);
+	uint32_t attempts = JOURNAL_ATTEMPTS(journal);
+	uint32_t resets = JOURNAL_RESETS(journal);
+	int32_t ret = PROV_OK;
+
+	if ((JOURNAL_FAILED(journal) == 0U) && (step < AUTOPROV_STEP_DONE))
+	{
+		if (attempts != 0U)
+		{
+			/* Coming back from a reset of the current step */
+			resets++;
+		}
+
+		while (step < AUTOPROV_STEP_DONE)
+		{
+			attempts++;
+			if (attempts > AUTOPROV_MAX_ATTEMPTS)
+			{
+				ret = PROV_ERR_RETRY_EXHAUSTED;
+				break;
+			}
+			Journal_Write(JOURNAL(step, attempts, resets, 0U));
+
+			ret = AutoProvisioning_Step(step);
+			if (ret != PROV_OK)
+			{
+				break;
+			}
+			step++;
+			attempts = 0U;
+		}
+
+		Journal_Write(JOURNAL(step, attempts, resets, (ret != PROV_OK) ? 1U : 0U));
+	}
+	else if (JOURNAL_FAILED(journal) != 0U)
+	{
+		ret = PROV_ERR_RETRY_EXHAUSTED;
+	}
+
+	if (ret == PROV_OK)
+	{
+		printf("AUTO: provisioned (TrustZone, watermarks, CLOSED, DA) after %lu reset(s)\r\n", resets);
+	}
+	else
+	{
+		printf("AUTO: failed at step %s (%s, attempt %lu)\r\n", StepNames[step], Prov_StatusName((Prov_Status_t)ret), attempts);
+	}
+	return ret;
+}
@@ -0,0 +1,24 @@
+#ifndef AUTO_PROVISIONING_H
+#define AUTO_PROVISIONING_H
+#include "main.h"
+
+/* Steps of the first boot sequence, in order */
+#define AUTOPROV_STEP_TZEN        (0U)
+#define AUTOPROV_STEP_WATERMARK   (1U)
+#define AUTOPROV_STEP_CLOSE       (2U)
+#define AUTOPROV_STEP_DA          (3U)
+#define AUTOPROV_STEP_DONE        (4U)
+
+/* Journal kept in a TAMP backup register : survives the resets caused by
+ * option byte and OBK changes, cleared by a regression.
+ *   [31:24] magic  [23:16] step  [15:8] attempts in step  [7:1] resets  [0] failed
+ */
+#define AUTOPROV_JOURNAL_INDEX    (0U)        /* TAMP_BKP0R */
+#define AUTOPROV_JOURNAL_MAGIC    (0xA5U)
+
+/* Entries in a step : CLOSE and DA each come back once after their reset */
+#define AUTOPROV_MAX_ATTEMPTS     (4U)
+
+int32_t AutoProvisioning_Run(void);
+
+#endif
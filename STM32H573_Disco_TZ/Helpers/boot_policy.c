@@ -0,0 +1,149 @@
+#include "boot_policy.h"
+#include "ob_config.h"
+#include "obk_directory.h"
+#include "usart.h"
+
+#define FNV_OFFSET                (0x811C9DC5U)
+#define FNV_PRIME                 (0x01000193U)
+
+static uint32_t Fnv_Update(uint32_t Hash, uint32_t Word)
+{
+	for (uint32_t i = 0U; i < 4U; i++)
+	{
+		Hash = (Hash ^ ((Word >> (8U * i)) & 0xFFU)) * FNV_PRIME;
+	}
+	return Hash;
+}
+
+/**
+  * @brief  Give access to the backup registers
+  * @note   The registers used by the provisioning journal and the boot policy
+  *         are made secure only.
+  * @retval None
+  */
+static void Backup_Access(void)
+{
+	__HAL_RCC_RTC_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+	if ((TAMP_S->SECCFGR & TAMP_SECCFGR_BKPRWSEC_Msk) < BOOT_POLICY_BKP_SECURE)
+	{
+		MODIFY_REG(TAMP_S->SECCFGR, TAMP_SECCFGR_BKPRWSEC_Msk, BOOT_POLICY_BKP_SECURE << TAMP_SECCFGR_BKPRWSEC_Pos);
+	}
+}
+
+/**
+  * @brief  Fingerprint of the provisioning state
+  * @note   Covers TZEN, both secure watermarks, PRODUCT_STATE, BOOT_UBE and the
+  *         OBK directory record, whose generation changes on each commit.
+  *         Not a security check : it only lets an unchanged device skip the
+  *         provisioning checks.
+  * @retval Fingerprint
+  */
+uint32_t BootPolicy_Fingerprint(void)
+{
+	uint32_t dir[OBK_DIR_SIZE / 4U] __ALIGNED(4);
+	uint32_t hash = FNV_OFFSET;
+
+	hash = Fnv_Update(hash, FLASH->OPTSR2_CUR & FLASH_OPTSR2_TZEN);
+	hash = Fnv_Update(hash, FLASH->OPTSR_CUR & (FLASH_OPTSR_PRODUCT_STATE_Msk | FLASH_OPTSR_BOOT_UBE_Msk));
+	hash = Fnv_Update(hash, FLASH->SECWM1R_CUR & (FLASH_SECWMR_SECWM_STRT_Msk | FLASH_SECWMR_SECWM_END_Msk));
+	hash = Fnv_Update(hash, FLASH->SECWM2R_CUR & (FLASH_SECWMR_SECWM_STRT_Msk | FLASH_SECWMR_SECWM_END_Msk));
+
+	if (OBKProvisioning_Read(OBK_DIR_OFFSET, dir, sizeof(dir), 0U) != PROV_OK)
+	{
+		/* Never matches a recorded fingerprint */
+		return 0U;
+	}
+	for (uint32_t i = 0U; i < (sizeof(dir) / 4U); i++)
+	{
+		hash = Fnv_Update(hash, dir[i]);
+	}
+	return hash;
+}
+
+/**
+  * @brief  Check if the menu was requested with the button or the UART window
+  * @retval 1 if requested, 0 otherwise
+  */
+static uint32_t BootPolicy_Override(void)
+{
+	GPIO_InitTypeDef gpio = {0};
+
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	gpio.Pin = BOOT_POLICY_BUTTON_PIN;
+	gpio.Mode = GPIO_MODE_INPUT;
+	gpio.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(BOOT_POLICY_BUTTON_PORT, &gpio);
+	if (HAL_GPIO_ReadPin(BOOT_POLICY_BUTTON_PORT, BOOT_POLICY_BUTTON_PIN) == BOOT_POLICY_BUTTON_ACTIVE)
+	{
+		return 1U;
+	}
+
+#if (BOOT_POLICY_WINDOW_MS > 0U)
+	uint8_t key;
+	printf("Press a key for the menu ...\r\n");
+	if (HAL_UART_Receive(&huart1, &key, 1, BOOT_POLICY_WINDOW_MS) == HAL_OK)
+	{
+		return 1U;
+	}
+#endif
+	return 0U;
+}
+
+/**
+  * @brief  Decide whether the provisioning menu can be skipped
+  * @note   Called at each boot before any trace. A few register reads and one
+  *         OBK directory read when the recorded fingerprint matches.
+  * @retval 1 to jump to the non secure application, 0 to provision
+  */
+uint32_t BootPolicy_FastPath(void)
+{
+	volatile uint32_t *pBkp;
+	uint32_t fingerprint;
+
+	Backup_Access();
+	pBkp = &TAMP_S->BKP0R + BOOT_POLICY_FP_INDEX;
+	if ((pBkp[0] != ~pBkp[1]) || (pBkp[0] == 0U))
+	{
+		/* Never recorded */
+		return 0U;
+	}
+
+	fingerprint = BootPolicy_Fingerprint();
+	if ((fingerprint != pBkp[0]) || (BootPolicy_Override() != 0U))
+	{
+		return 0U;
+	}
+	return 1U;
+}
+
+/**
+  * @brief  Record the fingerprint once the device is fully provisioned
+  * @note   Option bytes must match the desired configuration and the DA
+  *         credentials be registered in the OBK directory.
+  * @retval PROV_OK if recorded, PROV_ERR_STATE if the device is not fully
+  *         provisioned
+  */
+int32_t BootPolicy_Record(void)
+{
+	OBConfig_Snapshot_t current;
+	volatile uint32_t *pBkp;
+	uint32_t fingerprint;
+
+	OBConfig_Read(&current);
+	if ((OBConfig_Diff(&current, OB_CONFIG_FIELD_ALL) != 0U) || (OBKDirectory_Find(OBK_DIR_ID_DA) == NULL))
+	{
+		return PROV_ERR_STATE;
+	}
+
+	Backup_Access();
+	pBkp = &TAMP_S->BKP0R + BOOT_POLICY_FP_INDEX;
+	fingerprint = BootPolicy_Fingerprint();
+	if (pBkp[0] != fingerprint)
+	{
+		pBkp[0] = fingerprint;
+		pBkp[1] = ~fingerprint;
+		PRINTF("Provisioning fingerprint recorded : 0x%8.8lx\r\n", fingerprint);
+	}
+	return PROV_OK;
+}
@@ -0,0 +1,21 @@
+#ifndef BOOT_POLICY_H
+#define BOOT_POLICY_H
+#include "main.h"
+
+/* Fingerprint kept in two TAMP backup registers, value and complement */
+#define BOOT_POLICY_FP_INDEX      (1U)        /* TAMP_BKP1R, TAMP_BKP2R */
+#define BOOT_POLICY_BKP_SECURE    (3U)        /* Backup registers 0 to 2 secure only */
+
+/* Holding the USER button (PC13) at reset always shows the menu */
+#define BOOT_POLICY_BUTTON_PORT   GPIOC
+#define BOOT_POLICY_BUTTON_PIN    GPIO_PIN_13
+#define BOOT_POLICY_BUTTON_ACTIVE GPIO_PIN_SET
+
+/* Time to press a key on the UART to reach the menu, 0 for none */
+#define BOOT_POLICY_WINDOW_MS     (0U)
+
+uint32_t BootPolicy_Fingerprint(void);
+uint32_t BootPolicy_FastPath(void);
+int32_t BootPolicy_Record(void);
+
+#endif
@@ -0,0 +1,307 @@
+#include "entropy_pool.h"
+#include "rng.h"
+#include "string.h"
+
+#define ENTROPY_POOL_WORDS        (ENTROPY_POOL_SIZE / 4U)
+
+/* Free running counters, a word uses slot (counter % ENTROPY_POOL_WORDS).
+   Head is advanced by the RNG interrupt, Tail by readers with it masked. */
+static uint32_t Pool[ENTROPY_POOL_WORDS];
+static volatile uint32_t Head = 0U;
+static volatile uint32_t Tail = 0U;
+
+/* Continuous test : every word is compared with the previous one */
+static uint32_t LastWord = 0U;
+static uint32_t Primed = 0U;
+
+static volatile uint32_t Refilling = 0U;
+static volatile uint32_t Failed = 0U;
+static uint32_t Restarts = 0U;      /* Since the last accepted word */
+static uint32_t Recovering = 0U;    /* Errors reported by RNG_RecoverSeedError() itself */
+
+static EntropyPool_Stats_t Stats;
+
+/**
+  * @brief  Request the next words from the RNG if the pool has room
+  * @note   Called with the RNG interrupt masked or from it.
+  * @retval None
+  */
+static void EntropyPool_Refill(void)
+{
+  if ((Failed == 0U) && (Refilling == 0U) && ((Head - Tail) < ENTROPY_POOL_WORDS))
+  {
+    Refilling = 1U;
+    if (HAL_RNG_GenerateRandomNumber_IT(&hrng) != HAL_OK)
+    {
+      Refilling = 0U;
+    }
+  }
+}
+
+/**
+  * @brief  Clear the pool content
+  * @retval None
+  */
+static void EntropyPool_Drop(void)
+{
+  memset(Pool, 0x00, sizeof(Pool));
+  Tail = Head;
+  LastWord = 0U;
+  Primed = 0U;
+}
+
+/**
+  * @brief  Drop the pool content and restart the RNG after a failed test
+  * @note   After ENTROPY_POOL_MAX_RESTARTS restarts without an accepted word
+  *         the pool stops serving until EntropyPool_Init() is called again.
+  * @retval None
+  */
+static void EntropyPool_Restart(void)
+{
+  EntropyPool_Drop();
+  if (++Restarts > ENTROPY_POOL_MAX_RESTARTS)
+  {
+    Failed = 1U;
+    return;
+  }
+
+  /* Disabling the RNG restarts the noise source and its health tests */
+  __HAL_RNG_DISABLE(&hrng);
+  __HAL_RNG_ENABLE(&hrng);
+}
+
+/**
+  * @brief  Check one word and add it to the pool
+  * @param  Word Word read from the RNG
+  * @retval 0 if OK, 1 if the word repeats the previous one
+  */
+static uint32_t EntropyPool_Push(uint32_t Word)
+{
+  /* The first word after a start is only kept for the comparison */
+  if (Primed == 0U)
+  {
+    LastWord = Word;
+    Primed = 1U;
+    return 0U;
+  }
+  if (Word == LastWord)
+  {
+    Stats.Repetitions++;
+    return 1U;
+  }
+
+  LastWord = Word;
+  Restarts = 0U;
+  if ((Head - Tail) < ENTROPY_POOL_WORDS)
+  {
+    Pool[Head % ENTROPY_POOL_WORDS] = Word;
+    Head++;
+    Stats.Words++;
+  }
+  return 0U;
+}
+
+/**
+  * @brief  Start filling the pool from the RNG interrupt
+  * @note   MX_RNG_Init() must have been called. Calling it again clears a
+  *         failed pool and restarts the RNG.
+  * @retval None
+  */
+void EntropyPool_Init(void)
+{
+  HAL_NVIC_DisableIRQ(RNG_IRQn);
+
+  /* Any refill in progress is abandoned */
+  __HAL_RNG_DISABLE_IT(&hrng);
+  hrng.State = HAL_RNG_STATE_READY;
+  __HAL_UNLOCK(&hrng);
+
+  EntropyPool_Drop();
+  Refilling = 0U;
+  Failed = 0U;
+  Restarts = 0U;
+  EntropyPool_Refill();
+
+  HAL_NVIC_SetPriority(RNG_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(RNG_IRQn);
+}
+
+/**
+  * @brief  Copy random bytes from the pool, without waiting for the RNG
+  * @note   Whole words are consumed and cleared from the pool, the refill
+  *         restarts in the background.
+  * @param  pData Destination
+  * @param  Length Number of bytes, up to ENTROPY_POOL_SIZE
+  * @retval PROV_OK, PROV_ERR_PARAM for wrong parameters, PROV_ERR_STATE if
+  *         the pool holds fewer than Length bytes, PROV_ERR_CRYPTO if the RNG
+  *         failed
+  */
+int32_t EntropyPool_Get(void *pData, uint32_t Length)
+{
+  uint8_t *p_data = (uint8_t *)pData;
+  int32_t ret = PROV_OK;
+
+  if ((pData == NULL) || (Length == 0U) || (Length > ENTROPY_POOL_SIZE))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  HAL_NVIC_DisableIRQ(RNG_IRQn);
+
+  if (Failed != 0U)
+  {
+    ret = PROV_ERR_CRYPTO;
+  }
+  else if (((Head - Tail) * 4U) < Length)
+  {
+    Stats.Empty++;
+    ret = PROV_ERR_STATE;
+  }
+  else
+  {
+    for (uint32_t i = 0U; i < Length; i += 4U)
+    {
+      uint32_t *p_word = &Pool[Tail % ENTROPY_POOL_WORDS];
+
+      memcpy(&p_data[i], p_word, ((Length - i) < 4U) ? (Length - i) : (4U));
+      *p_word = 0U;
+      Tail++;
+    }
+    Stats.Served += Length;
+  }
+
+  EntropyPool_Refill();
+  HAL_NVIC_EnableIRQ(RNG_IRQn);
+
+  return ret;
+}
+
+/**
+  * @brief  Copy random bytes from the pool, waiting for its refill if needed
+  * @param  pData Destination
+  * @param  Length Number of bytes, up to ENTROPY_POOL_SIZE
+  * @param  Timeout Longest wait in ms
+  * @retval Status of EntropyPool_Get()
+  */
+int32_t EntropyPool_GetTimeout(void *pData, uint32_t Length, uint32_t Timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+
+  while ((EntropyPool_Available() < Length) && (Failed == 0U) && ((HAL_GetTick() - tickstart) < Timeout))
+  {
+  }
+  return EntropyPool_Get(pData, Length);
+}
+
+/**
+  * @brief  Number of bytes ready in the pool
+  * @retval Bytes, 0 once the RNG failed
+  */
+uint32_t EntropyPool_Available(void)
+{
+  return (Failed == 0U) ? ((Head - Tail) * 4U) : (0U);
+}
+
+/**
+  * @brief  Pool counters
+  * @param  pStats Filled with the counters
+  * @retval None
+  */
+void EntropyPool_GetStats(EntropyPool_Stats_t *pStats)
+{
+  HAL_NVIC_DisableIRQ(RNG_IRQn);
+  *pStats = Stats;
+  HAL_NVIC_EnableIRQ(RNG_IRQn);
+}
+
+/**
+  * @brief  Print the pool counters
+  * @retval None
+  */
+void EntropyPool_PrintStats(void)
+{
+  EntropyPool_Stats_t stats;
+
+  EntropyPool_GetStats(&stats);
+  PRINTF("Entropy pool : %lu/%lu bytes ready%s\r\n", EntropyPool_Available(), (uint32_t)ENTROPY_POOL_SIZE,
+         (Failed != 0U) ? " (RNG failed)" : "");
+  PRINTF("  Words       : %lu\r\n", stats.Words);
+  PRINTF("  Served      : %lu bytes\r\n", stats.Served);
+  PRINTF("  Empty       : %lu\r\n", stats.Empty);
+  PRINTF("  Repetitions : %lu\r\n", stats.Repetitions);
+  PRINTF("  Seed errors : %lu\r\n", stats.SeedErrors);
+  PRINTF("  Clock errors: %lu\r\n", stats.ClockErrors);
+}
+
+/**
+  * @brief  RNG data ready, from HAL_RNG_IRQHandler()
+  * @note   The RNG output FIFO holds several words, they are all taken while
+  *         the pool has room and no error is flagged.
+  * @param  hrng RNG handle
+  * @param  random32bit First word
+  * @retval None
+  */
+void HAL_RNG_ReadyDataCallback(RNG_HandleTypeDef *hrng, uint32_t random32bit)
+{
+  uint32_t word = random32bit;
+
+  Refilling = 0U;
+  while (EntropyPool_Push(word) == 0U)
+  {
+    if (((Head - Tail) >= ENTROPY_POOL_WORDS) || (READ_BIT(hrng->Instance->SR, RNG_SR_DRDY) == 0U) ||
+        (READ_BIT(hrng->Instance->SR, RNG_SR_SEIS | RNG_SR_CEIS) != 0U))
+    {
+      EntropyPool_Refill();
+      return;
+    }
+    word = hrng->Instance->DR;
+  }
+
+  EntropyPool_Restart();
+  EntropyPool_Refill();
+}
+
+/**
+  * @brief  RNG seed or clock error, from HAL_RNG_IRQHandler()
+  * @note   A seed error is recovered with RNG_RecoverSeedError(). Words
+  *         already in the pool were produced before the error and are kept.
+  *         The refill restarts unless the errors keep coming.
+  * @param  hrng RNG handle
+  * @retval None
+  */
+void HAL_RNG_ErrorCallback(RNG_HandleTypeDef *hrng)
+{
+  uint32_t error = HAL_RNG_GetError(hrng);
+  HAL_StatusTypeDef status = HAL_OK;
+
+  if (Recovering != 0U)
+  {
+    return;
+  }
+
+  Refilling = 0U;
+  if ((error & HAL_RNG_ERROR_SEED) != 0U)
+  {
+    Stats.SeedErrors++;
+    Recovering = 1U;
+    status = RNG_RecoverSeedError(hrng);
+    Recovering = 0U;
+  }
+  if ((error & HAL_RNG_ERROR_CLOCK) != 0U)
+  {
+    Stats.ClockErrors++;
+  }
+
+  /* HAL_RNG_IRQHandler() leaves the handle locked in error state */
+  hrng->ErrorCode = HAL_RNG_ERROR_NONE;
+  hrng->State = HAL_RNG_STATE_READY;
+  __HAL_UNLOCK(hrng);
+
+  if ((status != HAL_OK) || (++Restarts > ENTROPY_POOL_MAX_RESTARTS))
+  {
+    __HAL_RNG_DISABLE_IT(hrng);
+    Failed = 1U;
+    return;
+  }
+  EntropyPool_Refill();
+}
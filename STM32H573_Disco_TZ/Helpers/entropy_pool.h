@@ -0,0 +1,30 @@
+#ifndef ENTROPY_POOL_H
+#define ENTROPY_POOL_H
+#include "main.h"
+#include "prov_result.h"
+
+/* Random words kept ready in secure SRAM, refilled from the RNG interrupt */
+#ifndef ENTROPY_POOL_SIZE
+#define ENTROPY_POOL_SIZE         (256U)    /* Bytes, multiple of 4 */
+#endif
+
+/* Consecutive failed restarts before the pool stops serving */
+#define ENTROPY_POOL_MAX_RESTARTS (3U)
+
+typedef struct {
+    uint32_t Words;         /* Words accepted from the RNG */
+    uint32_t Served;        /* Bytes handed out */
+    uint32_t Empty;         /* Requests larger than the pool content */
+    uint32_t Repetitions;   /* Words equal to the previous one, pool dropped */
+    uint32_t SeedErrors;    /* Seed errors recovered by RNG_RecoverSeedError() */
+    uint32_t ClockErrors;
+  } EntropyPool_Stats_t;
+
+void EntropyPool_Init(void);
+int32_t EntropyPool_Get(void *pData, uint32_t Length);
+int32_t EntropyPool_GetTimeout(void *pData, uint32_t Length, uint32_t Timeout);
+uint32_t EntropyPool_Available(void);
+void EntropyPool_GetStats(EntropyPool_Stats_t *pStats);
+void EntropyPool_PrintStats(void);
+
+#endif
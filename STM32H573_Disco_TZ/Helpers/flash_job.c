@@ -0,0 +1,527 @@
+#include "flash_job.h"
+#include "perf_timer.h"
+#include <string.h>
+
+#define FLASH_JOB_FREE            (0U)
+#define FLASH_JOB_QUEUED          (1U)
+#define FLASH_JOB_RUNNING         (2U)
+#define FLASH_JOB_COMPLETE        (3U)
+
+#define FLASH_JOB_QUADWORD        (0x10U)
+#define FLASH_JOB_LAST_SECTOR     (0xFFFFFFFFU)   /* HAL end of operation value of the last erased sector */
+
+/* Interrupts enabled by the HAL for the other operations */
+#define FLASH_JOB_IT              (FLASH_IT_EOP | FLASH_IT_WRPERR | FLASH_IT_PGSERR | FLASH_IT_STRBERR | \
+                                   FLASH_IT_INCERR | FLASH_IT_OBKERR | FLASH_IT_OBKWERR)
+
+typedef struct {
+    FlashJob_t Job;
+    volatile uint32_t State;      /* FLASH_JOB_FREE ... */
+    volatile uint32_t Done;       /* Quad-words, sectors or operation completed */
+    uint32_t ReportedDone;        /* Last value given to pProgress */
+    uint32_t Start;               /* PerfTimer_Start() at launch */
+    uint32_t ElapsedUs;
+    Prov_Result_t Result;
+  } FlashJob_Slot_t;
+
+static FlashJob_Slot_t FlashJob_Slots[FLASH_JOB_QUEUE_SIZE];
+
+/* Free running counters, a job uses slot (counter % FLASH_JOB_QUEUE_SIZE).
+   Reported <= Started <= Submitted, at most one job runs at a time. */
+static volatile uint32_t FlashJob_Submitted = 0U;
+static volatile uint32_t FlashJob_Started = 0U;
+static uint32_t FlashJob_Reported = 0U;
+
+/* Set when a job fails : the jobs queued behind it depend on it and are dropped */
+static uint32_t FlashJob_Failed = 0U;
+static Prov_Result_t FlashJob_Failure;
+
+static uint32_t FlashJob_Initialized = 0U;
+
+/* Longest time between two idle callbacks of the last FlashJob_Wait() */
+static uint32_t FlashJob_MaxStallCycles = 0U;
+
+#if (FLASH_JOB_RAM_VECTORS != 0U)
+/* Cortex-M33 exceptions and device interrupts, VTOR needs the table size
+   rounded up to a power of two as alignment */
+#define FLASH_JOB_VECTORS         (16U + (uint32_t)LPTIM6_IRQn + 1U)
+
+static uint32_t FlashJob_RamVectors[FLASH_JOB_VECTORS] __ALIGNED(1024);
+static uint32_t FlashJob_FlashVtor = 0U;
+#endif
+
+static FLASH_JOB_RAMFUNC HAL_StatusTypeDef FlashJob_Launch(FlashJob_Slot_t *pSlot);
+static FLASH_JOB_RAMFUNC uint32_t FlashJob_StartNext(void);
+
+/**
+  * @brief  Enable the secure flash interrupt serviced from stm32h5xx_it.c
+  * @retval None
+  */
+void FlashJob_Init(void)
+{
+  if (FlashJob_Initialized == 0U)
+  {
+    PerfTimer_Init();
+    HAL_NVIC_SetPriority(FLASH_S_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(FLASH_S_IRQn);
+#if (FLASH_JOB_RAM_VECTORS != 0U)
+    FlashJob_FlashVtor = SCB->VTOR;
+    memcpy(FlashJob_RamVectors, (const void *)FlashJob_FlashVtor, sizeof(FlashJob_RamVectors));
+#endif
+    FlashJob_Initialized = 1U;
+  }
+}
+
+/**
+  * @brief  Select the SRAM or the flash vector table
+  * @note   The handlers stay where they are linked : the ones running during
+  *         a job (flash, SysTick) are placed in SRAM.
+  * @param  Ram 1 while jobs are pending, 0 once the queue is empty
+  * @retval None
+  */
+static FLASH_JOB_RAMFUNC void FlashJob_SelectVectors(uint32_t Ram)
+{
+#if (FLASH_JOB_RAM_VECTORS != 0U)
+  uint32_t vtor = (Ram != 0U) ? (uint32_t)FlashJob_RamVectors : FlashJob_FlashVtor;
+
+  if (SCB->VTOR != vtor)
+  {
+    SCB->VTOR = vtor;
+    __DSB();
+    __ISB();
+  }
+#else
+  UNUSED(Ram);
+#endif
+}
+
+/**
+  * @brief  Units of work of a job, for progress reporting
+  * @param  pJob Job
+  * @retval Quad-words or sectors, 1 for a single operation
+  */
+static FLASH_JOB_RAMFUNC uint32_t FlashJob_Total(const FlashJob_t *pJob)
+{
+  switch (pJob->Operation)
+  {
+    case FLASH_JOB_PROGRAM_OBK:
+    case FLASH_JOB_PROGRAM:
+    case FLASH_JOB_ERASE_SECTORS:
+      return pJob->Count;
+    default:
+      return 1U;
+  }
+}
+
+/**
+  * @brief  Result category of a failed job
+  * @param  Operation FLASH_JOB_xxx
+  * @retval Status
+  */
+static FLASH_JOB_RAMFUNC Prov_Status_t FlashJob_ErrorOf(uint32_t Operation)
+{
+  switch (Operation)
+  {
+    case FLASH_JOB_ERASE_OBK:
+    case FLASH_JOB_ERASE_SECTORS:
+      return PROV_ERR_FLASH_ERASE;
+    case FLASH_JOB_SWAP_OBK:
+      return PROV_ERR_OBK_SWAP;
+    default:
+      return PROV_ERR_FLASH_PROGRAM;
+  }
+}
+
+/**
+  * @brief  Job in flight
+  * @retval Slot, NULL if none
+  */
+static FLASH_JOB_RAMFUNC FlashJob_Slot_t *FlashJob_Current(void)
+{
+  FlashJob_Slot_t *pSlot;
+
+  if (FlashJob_Started == FlashJob_Reported)
+  {
+    return NULL;
+  }
+  pSlot = &FlashJob_Slots[(FlashJob_Started - 1U) % FLASH_JOB_QUEUE_SIZE];
+
+  return (pSlot->State == FLASH_JOB_RUNNING) ? pSlot : NULL;
+}
+
+/**
+  * @brief  End a job, reported by the next FlashJob_Poll()
+  * @param  pSlot Job
+  * @param  Result Result of the job
+  * @retval None
+  */
+static FLASH_JOB_RAMFUNC void FlashJob_Complete(FlashJob_Slot_t *pSlot, Prov_Result_t Result)
+{
+  if (pSlot->Job.Operation == FLASH_JOB_PROGRAM_OBK)
+  {
+    /* Left set by HAL_FLASH_Program_IT(), unlike HAL_FLASH_Program() */
+    CLEAR_BIT(FLASH->SECOBKCFGR, FLASH_OBKCFGR_ALT_SECT);
+  }
+  pSlot->ElapsedUs = PerfTimer_ElapsedUs(pSlot->Start);
+  pSlot->Result = Result;
+  pSlot->State = FLASH_JOB_COMPLETE;
+}
+
+/**
+  * @brief  Start one operation of a job
+  * @note   A program job starts one quad-word per call, the source is read
+  *         at that time.
+  * @param  pSlot Job
+  * @retval HAL status
+  */
+static FLASH_JOB_RAMFUNC HAL_StatusTypeDef FlashJob_Launch(FlashJob_Slot_t *pSlot)
+{
+  const FlashJob_t *pJob = &pSlot->Job;
+  FLASH_EraseInitTypeDef erase = {0U};
+  uint32_t offset = pSlot->Done * FLASH_JOB_QUADWORD;
+
+  switch (pJob->Operation)
+  {
+    case FLASH_JOB_ERASE_OBK:
+      erase.TypeErase = FLASH_TYPEERASE_OBK_ALT;
+      return HAL_FLASHEx_Erase_IT(&erase);
+
+    case FLASH_JOB_ERASE_SECTORS:
+      erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+      erase.Banks = pJob->Bank;
+      erase.Sector = pJob->Address;
+      erase.NbSectors = pJob->Count;
+      return HAL_FLASHEx_Erase_IT(&erase);
+
+    case FLASH_JOB_PROGRAM_OBK:
+      return HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_QUADWORD_OBK_ALT, pJob->Address + offset,
+                                  (uint32_t)&pJob->pData[offset / 4U]);
+
+    case FLASH_JOB_PROGRAM:
+      return HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_QUADWORD, pJob->Address + offset,
+                                  (uint32_t)&pJob->pData[offset / 4U]);
+
+    case FLASH_JOB_SWAP_OBK:
+      /* HAL_FLASHEx_OBK_Swap_IT() sets the interrupt enables in OBKCFGR,
+         where the swap offset overwrites them : enable them in SECCR */
+      SET_BIT(FLASH->SECCR, FLASH_JOB_IT);
+      return HAL_FLASHEx_OBK_Swap_IT(pJob->Count);
+
+    default:
+      return HAL_ERROR;
+  }
+}
+
+/**
+  * @brief  Start the next queued job once the previous one is reported
+  * @note   Jobs are started from thread context only, the interrupt just
+  *         chains the quad-words of a program job.
+  * @retval 1 if a job ended at once (dropped or failed to start), 0 otherwise
+  */
+static FLASH_JOB_RAMFUNC uint32_t FlashJob_StartNext(void)
+{
+  FlashJob_Slot_t *pSlot;
+  HAL_StatusTypeDef status;
+
+  if ((FlashJob_Started != FlashJob_Reported) || (FlashJob_Started == FlashJob_Submitted))
+  {
+    return 0U;
+  }
+
+  FlashJob_SelectVectors(1U);
+  pSlot = &FlashJob_Slots[FlashJob_Started % FLASH_JOB_QUEUE_SIZE];
+  pSlot->Start = PerfTimer_Start();
+  pSlot->State = FLASH_JOB_RUNNING;
+  FlashJob_Started++;
+
+  if (FlashJob_Failed != 0U)
+  {
+    FlashJob_Complete(pSlot, FlashJob_Failure);
+    return 1U;
+  }
+
+  status = FlashJob_Launch(pSlot);
+  if (status != HAL_OK)
+  {
+    FlashJob_Complete(pSlot, Prov_Fail(FlashJob_ErrorOf(pSlot->Job.Operation), status));
+    return 1U;
+  }
+  return 0U;
+}
+
+/**
+  * @brief  Queue a flash operation
+  * @note   The flash and OBK areas must be unlocked until the job completes.
+  *         Blocking HAL flash calls must not be made while jobs are pending.
+  * @param  pJob Job, copied
+  * @retval HAL_OK if queued, HAL_BUSY if the queue is full, HAL_ERROR if invalid
+  */
+HAL_StatusTypeDef FlashJob_Submit(const FlashJob_t *pJob)
+{
+  FlashJob_Slot_t *pSlot;
+
+  if ((pJob == NULL) || (pJob->Operation > FLASH_JOB_PROGRAM))
+  {
+    return HAL_ERROR;
+  }
+  if (((pJob->Operation == FLASH_JOB_PROGRAM_OBK) || (pJob->Operation == FLASH_JOB_PROGRAM)) &&
+      (pJob->pData == NULL))
+  {
+    return HAL_ERROR;
+  }
+  if ((FlashJob_Total(pJob) == 0U) || ((FlashJob_Submitted - FlashJob_Reported) >= FLASH_JOB_QUEUE_SIZE))
+  {
+    return (FlashJob_Total(pJob) == 0U) ? HAL_ERROR : HAL_BUSY;
+  }
+
+  FlashJob_Init();
+
+  pSlot = &FlashJob_Slots[FlashJob_Submitted % FLASH_JOB_QUEUE_SIZE];
+  pSlot->Job = *pJob;
+  pSlot->Done = 0U;
+  pSlot->ReportedDone = 0U;
+  pSlot->State = FLASH_JOB_QUEUED;
+  FlashJob_Submitted++;
+
+  (void) FlashJob_StartNext();
+  return HAL_OK;
+}
+
+/**
+  * @brief  Report progress and completions, start the next job
+  * @note   Callbacks run here, in the caller's context : they can print or
+  *         submit new jobs.
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void FlashJob_Poll(void)
+{
+  do
+  {
+    while (FlashJob_Reported != FlashJob_Started)
+    {
+      FlashJob_Slot_t *pSlot = &FlashJob_Slots[FlashJob_Reported % FLASH_JOB_QUEUE_SIZE];
+      uint32_t done = pSlot->Done;
+      Prov_Result_t result;
+      uint32_t elapsed;
+
+      if ((done != pSlot->ReportedDone) && (pSlot->Job.pProgress != NULL))
+      {
+        pSlot->ReportedDone = done;
+        pSlot->Job.pProgress(pSlot->Job.pContext, done, FlashJob_Total(&pSlot->Job));
+      }
+      if (pSlot->State != FLASH_JOB_COMPLETE)
+      {
+        break;
+      }
+
+      result = pSlot->Result;
+      elapsed = pSlot->ElapsedUs;
+      if ((result.Status != PROV_OK) && (FlashJob_Failed == 0U))
+      {
+        FlashJob_Failed = 1U;
+        FlashJob_Failure = result;
+      }
+      pSlot->State = FLASH_JOB_FREE;
+      FlashJob_Reported++;
+      if (FlashJob_Reported == FlashJob_Submitted)
+      {
+        FlashJob_Failed = 0U;
+        FlashJob_SelectVectors(0U);
+      }
+
+      if (pSlot->Job.pDone != NULL)
+      {
+        pSlot->Job.pDone(pSlot->Job.pContext, &result, elapsed);
+      }
+    }
+  } while (FlashJob_StartNext() != 0U);
+}
+
+/**
+  * @brief  Tell whether jobs are pending
+  * @retval 1 until the last job is reported, 0 otherwise
+  */
+FLASH_JOB_RAMFUNC uint32_t FlashJob_IsBusy(void)
+{
+  return (FlashJob_Reported != FlashJob_Submitted) ? 1U : 0U;
+}
+
+/**
+  * @brief  Wait for all the queued jobs
+  * @note   FlashJob_IdleCallback() runs while the flash is busy, the
+  *         longest gap between two calls is kept for
+  *         FlashJob_GetMaxStallUs().
+  * @param  Timeout Timeout in ms
+  * @retval HAL_OK once every job is reported, HAL_TIMEOUT if aborted
+  */
+FLASH_JOB_RAMFUNC HAL_StatusTypeDef FlashJob_Wait(uint32_t Timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+  uint32_t last = DWT->CYCCNT;
+
+  FlashJob_MaxStallCycles = 0U;
+  FlashJob_Poll();
+  while (FlashJob_IsBusy() != 0U)
+  {
+    uint32_t now;
+
+    if ((HAL_GetTick() - tickstart) > Timeout)
+    {
+      FlashJob_Abort();
+      return HAL_TIMEOUT;
+    }
+    FlashJob_IdleCallback();
+    FlashJob_Poll();
+
+    /* A fetch from the busy bank holds the loop until the operation ends */
+    now = DWT->CYCCNT;
+    if ((now - last) > FlashJob_MaxStallCycles)
+    {
+      FlashJob_MaxStallCycles = now - last;
+    }
+    last = now;
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Longest stall of the last FlashJob_Wait()
+  * @note   Time between two FlashJob_IdleCallback() calls : how long the
+  *         console could not be serviced.
+  * @retval Microseconds
+  */
+uint32_t FlashJob_GetMaxStallUs(void)
+{
+  return FlashJob_MaxStallCycles / (SystemCoreClock / 1000000U);
+}
+
+/**
+  * @brief  Drop the pending jobs
+  * @note   An operation already started completes in the flash, its job is
+  *         reported with HAL_TIMEOUT and the queued ones are dropped.
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void FlashJob_Abort(void)
+{
+  FlashJob_Slot_t *pSlot;
+  uint32_t primask;
+
+  if (FlashJob_IsBusy() == 0U)
+  {
+    return;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  pSlot = FlashJob_Current();
+  if (pSlot != NULL)
+  {
+    FlashJob_Complete(pSlot, Prov_Fail(FlashJob_ErrorOf(pSlot->Job.Operation), HAL_TIMEOUT));
+  }
+  __set_PRIMASK(primask);
+
+  if (FlashJob_Failed == 0U)
+  {
+    FlashJob_Failed = 1U;
+    FlashJob_Failure = Prov_Fail(PROV_ERR_STATE, HAL_TIMEOUT);
+  }
+  FlashJob_Poll();
+}
+
+/**
+  * @brief  Provide a tick value in millisecond
+  * @note   Overrides the HAL weak function so that FlashJob_Wait() and the
+  *         HAL flash driver timeouts do not fetch from the busy bank.
+  * @retval tick value
+  */
+FLASH_JOB_RAMFUNC uint32_t HAL_GetTick(void)
+{
+  return uwTick;
+}
+
+/**
+  * @brief  Increment the tick from SysTick_Handler
+  * @note   Overrides the HAL weak function, SysTick keeps running from SRAM
+  *         while a job is pending.
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void HAL_IncTick(void)
+{
+  uwTick += (uint32_t)uwTickFreq;
+}
+
+/**
+  * @brief  Run while FlashJob_Wait() waits for the flash
+  * @note   This function should not be modified, when needed it can be
+  *         implemented in the user file. usart.c services the console.
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC __weak void FlashJob_IdleCallback(void)
+{
+  __WFI();
+}
+
+/**
+  * @brief  Flash end of operation, chains the quad-words of a program job
+  * @param  ReturnValue Last erased sector, FLASH_JOB_LAST_SECTOR at the end
+  *         of a sector erase
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+  FlashJob_Slot_t *pSlot = FlashJob_Current();
+  HAL_StatusTypeDef status;
+
+  if (pSlot == NULL)
+  {
+    /* Not started by the queue, or aborted */
+    return;
+  }
+
+  pSlot->Done++;
+  switch (pSlot->Job.Operation)
+  {
+    case FLASH_JOB_ERASE_SECTORS:
+      if (ReturnValue != FLASH_JOB_LAST_SECTOR)
+      {
+        /* The HAL erases the next sector */
+        return;
+      }
+      break;
+
+    case FLASH_JOB_PROGRAM_OBK:
+    case FLASH_JOB_PROGRAM:
+      if (pSlot->Done < pSlot->Job.Count)
+      {
+        status = FlashJob_Launch(pSlot);
+        if (status != HAL_OK)
+        {
+          FlashJob_Complete(pSlot, Prov_Fail(PROV_ERR_FLASH_PROGRAM, status));
+        }
+        return;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  FlashJob_Complete(pSlot, Prov_Ok());
+}
+
+/**
+  * @brief  Flash operation error, the error flags are in HAL_FLASH_GetError()
+  * @param  ReturnValue Unused
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue)
+{
+  FlashJob_Slot_t *pSlot = FlashJob_Current();
+
+  UNUSED(ReturnValue);
+  if (pSlot != NULL)
+  {
+    FlashJob_Complete(pSlot, Prov_Fail(FlashJob_ErrorOf(pSlot->Job.Operation), HAL_ERROR));
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef FLASH_JOB_H
+#define FLASH_JOB_H
+#include "main.h"
+#include "prov_result.h"
+
+/* Operations run by the queue */
+#define FLASH_JOB_ERASE_OBK       (0U)   /* Erase the alternate OBK sector */
+#define FLASH_JOB_PROGRAM_OBK     (1U)   /* Program quad-words in the alternate OBK sector */
+#define FLASH_JOB_SWAP_OBK        (2U)   /* Swap the OBK sectors */
+#define FLASH_JOB_ERASE_SECTORS   (3U)
+#define FLASH_JOB_PROGRAM         (4U)   /* Program quad-words in user flash */
+
+/* Code running while the flash is busy, copied to SRAM with .data by the
+   startup code : fetches from bank 1 stall during a bank 1 or OBK operation.
+   Jobs on bank 2 do not stall the secure image. Build with
+   -DFLASH_JOB_RAMFUNC= to keep it in flash and compare the stall time. */
+#ifndef FLASH_JOB_RAMFUNC
+#define FLASH_JOB_RAMFUNC         __attribute__((section(".RamFunc"), noinline))
+#endif
+
+/* Vector table copied to SRAM and selected in VTOR while jobs are pending,
+   so that taking an interrupt does not fetch its vector from bank 1. Build
+   with -DFLASH_JOB_RAM_VECTORS=0 to keep the flash table. */
+#ifndef FLASH_JOB_RAM_VECTORS
+#define FLASH_JOB_RAM_VECTORS     (1U)
+#endif
+
+#ifndef FLASH_JOB_QUEUE_SIZE
+#define FLASH_JOB_QUEUE_SIZE      (8U)
+#endif
+
+/* Called from FlashJob_Poll(), never from the flash interrupt */
+typedef void (*FlashJob_Done_t)(void *pContext, const Prov_Result_t *pResult, uint32_t ElapsedUs);
+typedef void (*FlashJob_Progress_t)(void *pContext, uint32_t Done, uint32_t Total);
+
+typedef struct {
+    uint32_t Operation;             /* FLASH_JOB_xxx */
+    uint32_t Address;               /* Destination of a program, first sector of an erase */
+    const uint32_t *pData;          /* Source of a program, read when each quad-word starts */
+    uint32_t Count;                 /* Quad-words to program, sectors to erase or swap offset */
+    uint32_t Bank;                  /* FLASH_BANK_x of a sector erase */
+    FlashJob_Done_t pDone;          /* Optional */
+    FlashJob_Progress_t pProgress;  /* Optional */
+    void *pContext;
+  } FlashJob_t;
+
+void FlashJob_Init(void);
+HAL_StatusTypeDef FlashJob_Submit(const FlashJob_t *pJob);
+void FlashJob_Poll(void);
+uint32_t FlashJob_IsBusy(void);
+HAL_StatusTypeDef FlashJob_Wait(uint32_t Timeout);
+void FlashJob_Abort(void);
+void FlashJob_IdleCallback(void);
+uint32_t FlashJob_GetMaxStallUs(void);
+
+#endif
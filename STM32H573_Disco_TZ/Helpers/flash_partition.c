@@ -0,0 +1,243 @@
+#include "flash_partition.h"
+#include "memory_map.h"
+#include "flash_job.h"
+
+/* Secure data sectors at the end of bank1 (MEMORY_MAP_S_DATA_START), after
+   the non secure spare flash. Block-based attributes are volatile : the
+   table is applied at each boot and can be changed without OB launch. */
+#define FLASH_PARTITION_S_DATA_SECTOR (MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_DATA_START) / MEMORY_MAP_FLASH_SECTOR_SIZE)
+#define FLASH_PARTITION_S_DATA_NB     (MEMORY_MAP_S_DATA_SIZE / MEMORY_MAP_FLASH_SECTOR_SIZE)
+
+static const FlashPartition_Region_t FlashPartition_Table[] = {
+  { FLASH_BANK_1, FLASH_PARTITION_S_DATA_SECTOR, FLASH_PARTITION_S_DATA_NB, FLASH_PARTITION_SECURE | FLASH_PARTITION_PRIV,
+    "Secure key store" },
+};
+
+#define FLASH_PARTITION_NB_REGIONS  (sizeof(FlashPartition_Table) / sizeof(FlashPartition_Table[0]))
+#define FLASH_PARTITION_ERASE_TIMEOUT (1000U)
+
+/**
+  * @brief  Check that a sector can take block-based attributes
+  * @note   Sectors below the watermark are secure anyway and bank2 holds the
+  *         non secure application.
+  * @param  Bank FLASH_BANK_1 or FLASH_BANK_2
+  * @param  Sector Sector in the bank
+  * @retval 1 if allowed, 0 otherwise
+  */
+static uint32_t FlashPartition_IsAllowed(uint32_t Bank, uint32_t Sector)
+{
+  uint32_t offset = ((Bank == FLASH_BANK_2) ? FLASH_BANK_SIZE : 0U) + (Sector * FLASH_SECTOR_SIZE);
+
+  if ((Sector >= FLASH_SECTOR_NB) || ((Bank != FLASH_BANK_1) && (Bank != FLASH_BANK_2)))
+  {
+    return 0U;
+  }
+#if (MEMORY_MAP_WM1_START == 0U)
+  if ((Bank == FLASH_BANK_1) && (Sector <= MEMORY_MAP_WM1_END))
+#else
+  if ((Bank == FLASH_BANK_1) && (Sector >= MEMORY_MAP_WM1_START) && (Sector <= MEMORY_MAP_WM1_END))
+#endif
+  {
+    return 0U;
+  }
+  if ((offset >= MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_FLASH_START)) &&
+      (offset < MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_FLASH_START + MEMORY_MAP_NS_FLASH_SIZE)))
+  {
+    return 0U;
+  }
+  return 1U;
+}
+
+/**
+  * @brief  Write one type of block-based attributes of a bank if they differ
+  * @param  Bank FLASH_BANK_1 or FLASH_BANK_2
+  * @param  Type FLASH_BB_SEC or FLASH_BB_PRIV
+  * @param  pMask Attribute bit per sector
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef FlashPartition_Write(uint32_t Bank, uint32_t Type, const uint32_t *pMask)
+{
+  FLASH_BBAttributesTypeDef bb = {0};
+  uint32_t i;
+
+  bb.Bank = Bank;
+  bb.BBAttributesType = Type;
+  HAL_FLASHEx_GetConfigBBAttributes(&bb);
+  for (i = 0U; i < FLASH_BLOCKBASED_NB_REG; i++)
+  {
+    if (bb.BBAttributes_array[i] != pMask[i])
+    {
+      break;
+    }
+  }
+  if (i == FLASH_BLOCKBASED_NB_REG)
+  {
+    return HAL_OK;
+  }
+
+  for (i = 0U; i < FLASH_BLOCKBASED_NB_REG; i++)
+  {
+    bb.BBAttributes_array[i] = pMask[i];
+  }
+  return HAL_FLASHEx_ConfigBBAttributes(&bb);
+}
+
+/**
+  * @brief  Set the block-based attributes of the partition table
+  * @note   Called at each boot, before the non secure application starts.
+  *         Sectors not in the table keep the attributes given by the
+  *         watermarks.
+  * @retval PROV_OK, PROV_ERR_PARAM if the table is invalid,
+  *         PROV_ERR_FLASH_PROGRAM on write error
+  */
+int32_t FlashPartition_Apply(void)
+{
+  uint32_t sec[2][FLASH_BLOCKBASED_NB_REG] = { 0U };
+  uint32_t priv[2][FLASH_BLOCKBASED_NB_REG] = { 0U };
+
+  for (uint32_t r = 0U; r < FLASH_PARTITION_NB_REGIONS; r++)
+  {
+    const FlashPartition_Region_t *pRegion = &FlashPartition_Table[r];
+    uint32_t b = (pRegion->Bank == FLASH_BANK_2) ? 1U : 0U;
+
+    for (uint32_t s = pRegion->FirstSector; s < (pRegion->FirstSector + pRegion->NbSectors); s++)
+    {
+      if (FlashPartition_IsAllowed(pRegion->Bank, s) == 0U)
+      {
+        printf("Flash partition %s : sector 0x%lx not allowed\r\n", pRegion->Name, s);
+        return PROV_ERR_PARAM;
+      }
+      if ((pRegion->Attributes & FLASH_PARTITION_SECURE) != 0U)
+      {
+        sec[b][s / 32U] |= 1UL << (s % 32U);
+      }
+      if ((pRegion->Attributes & FLASH_PARTITION_PRIV) != 0U)
+      {
+        priv[b][s / 32U] |= 1UL << (s % 32U);
+      }
+    }
+  }
+
+  if ((FlashPartition_Write(FLASH_BANK_1, FLASH_BB_SEC, sec[0]) != HAL_OK) ||
+      (FlashPartition_Write(FLASH_BANK_2, FLASH_BB_SEC, sec[1]) != HAL_OK) ||
+      (FlashPartition_Write(FLASH_BANK_1, FLASH_BB_PRIV, priv[0]) != HAL_OK) ||
+      (FlashPartition_Write(FLASH_BANK_2, FLASH_BB_PRIV, priv[1]) != HAL_OK))
+  {
+    return PROV_ERR_FLASH_PROGRAM;
+  }
+  return PROV_OK;
+}
+
+/**
+  * @brief  End of a sector erase
+  * @param  pContext Prov_Status_t receiving the result
+  * @param  pResult Result of the erase
+  * @param  ElapsedUs Duration of the erase
+  * @retval None
+  */
+static void FlashPartition_EraseDone(void *pContext, const Prov_Result_t *pResult, uint32_t ElapsedUs)
+{
+  UNUSED(ElapsedUs);
+  *(Prov_Status_t *)pContext = pResult->Status;
+}
+
+/**
+  * @brief  Change the attributes of one sector at run time
+  * @note   No option byte launch nor reset. A sector given back to the non
+  *         secure side is erased first so that no secure data leaks. The
+  *         change lasts until the next reset, when the table applies again.
+  * @param  Bank FLASH_BANK_1 or FLASH_BANK_2
+  * @param  Sector Sector in the bank
+  * @param  Attributes FLASH_PARTITION_xxx
+  * @retval PROV_OK, PROV_ERR_PARAM if the sector is not allowed,
+  *         PROV_ERR_FLASH_ERASE on erase error, PROV_ERR_FLASH_PROGRAM on
+  *         write error
+  */
+int32_t FlashPartition_Set(uint32_t Bank, uint32_t Sector, uint32_t Attributes)
+{
+  FLASH_BBAttributesTypeDef bb = {0};
+  uint32_t bit = 1UL << (Sector % 32U);
+  uint32_t reg = Sector / 32U;
+
+  if (FlashPartition_IsAllowed(Bank, Sector) == 0U)
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  bb.Bank = Bank;
+  bb.BBAttributesType = FLASH_BB_SEC;
+  HAL_FLASHEx_GetConfigBBAttributes(&bb);
+  if (((bb.BBAttributes_array[reg] & bit) != 0U) && ((Attributes & FLASH_PARTITION_SECURE) == 0U))
+  {
+    FlashJob_t job = {0};
+    Prov_Status_t erased = PROV_ERR_FLASH_ERASE;
+    HAL_StatusTypeDef status;
+
+    /* The console keeps running while the sector is erased */
+    job.Operation = FLASH_JOB_ERASE_SECTORS;
+    job.Bank = Bank;
+    job.Address = Sector;
+    job.Count = 1U;
+    job.pDone = FlashPartition_EraseDone;
+    job.pContext = &erased;
+    HAL_FLASH_Unlock();
+    status = FlashJob_Submit(&job);
+    if (status == HAL_OK)
+    {
+      status = FlashJob_Wait(FLASH_PARTITION_ERASE_TIMEOUT);
+    }
+    HAL_FLASH_Lock();
+    if ((status != HAL_OK) || (erased != PROV_OK))
+    {
+      return PROV_ERR_FLASH_ERASE;
+    }
+  }
+
+  if ((Attributes & FLASH_PARTITION_SECURE) != 0U)
+  {
+    bb.BBAttributes_array[reg] |= bit;
+  }
+  else
+  {
+    bb.BBAttributes_array[reg] &= ~bit;
+  }
+  if (HAL_FLASHEx_ConfigBBAttributes(&bb) != HAL_OK)
+  {
+    return PROV_ERR_FLASH_PROGRAM;
+  }
+
+  bb.BBAttributesType = FLASH_BB_PRIV;
+  HAL_FLASHEx_GetConfigBBAttributes(&bb);
+  if ((Attributes & FLASH_PARTITION_PRIV) != 0U)
+  {
+    bb.BBAttributes_array[reg] |= bit;
+  }
+  else
+  {
+    bb.BBAttributes_array[reg] &= ~bit;
+  }
+  return (HAL_FLASHEx_ConfigBBAttributes(&bb) != HAL_OK) ? PROV_ERR_FLASH_PROGRAM : PROV_OK;
+}
+
+/**
+  * @brief  Check if a sector is secure, by watermark or block-based attribute
+  * @param  Bank FLASH_BANK_1 or FLASH_BANK_2
+  * @param  Sector Sector in the bank
+  * @retval 1 if secure, 0 otherwise
+  */
+uint32_t FlashPartition_IsSecure(uint32_t Bank, uint32_t Sector)
+{
+  uint32_t wm = (Bank == FLASH_BANK_2) ? FLASH->SECWM2R_CUR : FLASH->SECWM1R_CUR;
+  uint32_t start = (wm & FLASH_SECWMR_SECWM_STRT_Msk) >> FLASH_SECWMR_SECWM_STRT_Pos;
+  uint32_t end = (wm & FLASH_SECWMR_SECWM_END_Msk) >> FLASH_SECWMR_SECWM_END_Pos;
+  FLASH_BBAttributesTypeDef bb = {0};
+
+  if ((Sector >= start) && (Sector <= end))
+  {
+    return 1U;
+  }
+  bb.Bank = Bank;
+  bb.BBAttributesType = FLASH_BB_SEC;
+  HAL_FLASHEx_GetConfigBBAttributes(&bb);
+  return ((bb.BBAttributes_array[Sector / 32U] & (1UL << (Sector % 32U))) != 0U) ? 1U : 0U;
+}
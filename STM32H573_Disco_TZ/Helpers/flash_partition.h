@@ -0,0 +1,24 @@
+#ifndef FLASH_PARTITION_H
+#define FLASH_PARTITION_H
+#include "main.h"
+
+/* Attributes of a partition */
+#define FLASH_PARTITION_NS        (0U)
+#define FLASH_PARTITION_SECURE    (1U << 0)
+#define FLASH_PARTITION_PRIV      (1U << 1)
+
+/* Sectors whose attributes are set at boot with the block-based registers,
+   on top of the secure watermarks */
+typedef struct {
+    uint32_t Bank;          /* FLASH_BANK_1 or FLASH_BANK_2 */
+    uint32_t FirstSector;
+    uint32_t NbSectors;
+    uint32_t Attributes;    /* FLASH_PARTITION_xxx */
+    const char *Name;
+  } FlashPartition_Region_t;
+
+int32_t FlashPartition_Apply(void);
+int32_t FlashPartition_Set(uint32_t Bank, uint32_t Sector, uint32_t Attributes);
+uint32_t FlashPartition_IsSecure(uint32_t Bank, uint32_t Sector);
+
+#endif
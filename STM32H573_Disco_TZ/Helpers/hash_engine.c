@@ -0,0 +1,252 @@
+#include "hash_engine.h"
+#include "string.h" //For memcpy
+
+/* Bytes given to HAL_HASH_Accumulate per call, bounds the time of each call */
+#define HASH_ENGINE_BLOCK         (0x400U)
+#define HASH_ENGINE_TIMEOUT       (10U)
+
+DMA_HandleTypeDef hdma_hash_in;
+
+static HASH_HandleTypeDef hhash_engine;
+
+/**
+  * @brief  Initialize the HASH peripheral for SHA256 on first use
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef Engine_Setup(void)
+{
+  if (HAL_HASH_GetState(&hhash_engine) == HAL_HASH_STATE_READY)
+  {
+    return HAL_OK;
+  }
+  if (HAL_HASH_GetState(&hhash_engine) != HAL_HASH_STATE_RESET)
+  {
+    return HAL_BUSY;
+  }
+
+  hhash_engine.Instance = HASH;
+  hhash_engine.Init.DataType = HASH_BYTE_SWAP;
+  hhash_engine.Init.Algorithm = HASH_ALGOSELECTION_SHA256;
+  return HAL_HASH_Init(&hhash_engine);
+}
+
+/**
+  * @brief  Start a SHA256 computation
+  * @note   A computation left unfinished is dropped : the configuration
+  *         resets the HAL phase, so the next HAL_HASH_Accumulate() sets INIT
+  *         and starts a new digest.
+  * @param  pCtx Context of the computation
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_Init(HashEngine_Ctx_t *pCtx)
+{
+  HASH_ConfigTypeDef conf = {0};
+
+  memset(pCtx, 0x00, sizeof(HashEngine_Ctx_t));
+  if (Engine_Setup() != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+
+  conf.DataType = HASH_BYTE_SWAP;
+  conf.Algorithm = HASH_ALGOSELECTION_SHA256;
+  return HAL_HASH_SetConfig(&hhash_engine, &conf);
+}
+
+/**
+  * @brief  Hash the next part of the message
+  * @note   Any length is accepted. Whole words are fed to the HASH peripheral
+  *         by blocks of HASH_ENGINE_BLOCK bytes, the last 1 to 4 bytes are kept
+  *         back so that HashEngine_Final() always has data for the last block.
+  * @param  pCtx Context of the computation
+  * @param  pData Data to hash
+  * @param  Length Number of bytes
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_Update(HashEngine_Ctx_t *pCtx, const void *pData, uint32_t Length)
+{
+  const uint8_t *p_data = (const uint8_t *)pData;
+
+  pCtx->Total += Length;
+  while (Length != 0U)
+  {
+    uint32_t n;
+
+    if (pCtx->CarryLength == sizeof(pCtx->Carry))
+    {
+      if (HAL_HASH_Accumulate(&hhash_engine, pCtx->Carry, sizeof(pCtx->Carry), HASH_ENGINE_TIMEOUT) != HAL_OK)
+      {
+        return HAL_ERROR;
+      }
+      pCtx->CarryLength = 0U;
+    }
+
+    if ((pCtx->CarryLength == 0U) && (Length > sizeof(pCtx->Carry)))
+    {
+      /* Whole words, at least one byte left for the carry */
+      n = (Length - 1U) & ~3U;
+      n = (n > HASH_ENGINE_BLOCK) ? HASH_ENGINE_BLOCK : n;
+      if (HAL_HASH_Accumulate(&hhash_engine, p_data, n, HASH_ENGINE_TIMEOUT) != HAL_OK)
+      {
+        return HAL_ERROR;
+      }
+    }
+    else
+    {
+      n = sizeof(pCtx->Carry) - pCtx->CarryLength;
+      n = (n > Length) ? Length : n;
+      memcpy(&pCtx->Carry[pCtx->CarryLength], p_data, n);
+      pCtx->CarryLength += n;
+    }
+    p_data += n;
+    Length -= n;
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Hash the kept back bytes and read the digest
+  * @note   Nothing is kept back only for an empty message, its digest is
+  *         computed from no data (NBLW = 0).
+  * @param  pCtx Context of the computation
+  * @param  pDigest SHA256 digest (HASH_ENGINE_DIGEST_LENGTH bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_Final(HashEngine_Ctx_t *pCtx, uint8_t *pDigest)
+{
+  HAL_StatusTypeDef status = HAL_ERROR;
+
+  if ((pCtx->CarryLength != 0U) || (pCtx->Total == 0U))
+  {
+    status = HAL_HASH_AccumulateLast(&hhash_engine, pCtx->Carry, pCtx->CarryLength, pDigest, HASH_ENGINE_TIMEOUT);
+  }
+  memset(pCtx, 0x00, sizeof(HashEngine_Ctx_t));
+
+  return status;
+}
+
+/**
+  * @brief  Compute the SHA256 of a buffer
+  * @param  pData Data to hash
+  * @param  Length Number of bytes
+  * @param  pDigest SHA256 digest (HASH_ENGINE_DIGEST_LENGTH bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_SHA256(const void *pData, uint32_t Length, uint8_t *pDigest)
+{
+  HashEngine_Ctx_t ctx;
+
+  if ((HashEngine_Init(&ctx) != HAL_OK) ||
+      (HashEngine_Update(&ctx, pData, Length) != HAL_OK))
+  {
+    return HAL_ERROR;
+  }
+  return HashEngine_Final(&ctx, pDigest);
+}
+
+/**
+  * @brief  Start the SHA256 of a buffer through GPDMA1
+  * @note   The CPU is free until HashEngine_PollDMA() reports the end of the
+  *         computation, the digest is then available in pDigest.
+  * @param  pData Data to hash (aligned on 4 bytes)
+  * @param  Length Number of bytes, up to HASH_ENGINE_DMA_MAX_SIZE
+  * @param  pDigest SHA256 digest (HASH_ENGINE_DIGEST_LENGTH bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_StartDMA(const void *pData, uint32_t Length, uint8_t *pDigest)
+{
+  if ((Length == 0U) || (Length > HASH_ENGINE_DMA_MAX_SIZE) || (Engine_Setup() != HAL_OK))
+  {
+    return HAL_ERROR;
+  }
+
+  hhash_engine.ErrorCode = HAL_HASH_ERROR_NONE;
+  return HAL_HASH_Start_DMA(&hhash_engine, (const uint8_t *)pData, Length, pDigest);
+}
+
+/**
+  * @brief  Check the progress of a DMA computation
+  * @retval HAL_BUSY while the transfer runs, HAL_OK once the digest is read, HAL_ERROR otherwise
+  */
+HAL_StatusTypeDef HashEngine_PollDMA(void)
+{
+  if (HAL_HASH_GetState(&hhash_engine) == HAL_HASH_STATE_BUSY)
+  {
+    return HAL_BUSY;
+  }
+
+  return (HAL_HASH_GetError(&hhash_engine) == HAL_HASH_ERROR_NONE) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+  * @brief  Wait for the end of a DMA computation
+  * @param  Timeout Timeout in ms
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HashEngine_WaitDMA(uint32_t Timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+  HAL_StatusTypeDef status;
+
+  while ((status = HashEngine_PollDMA()) == HAL_BUSY)
+  {
+    if ((HAL_GetTick() - tickstart) > Timeout)
+    {
+      /* Restart from a clean peripheral on next use */
+      (void) HAL_DMA_Abort(&hdma_hash_in);
+      (void) HAL_HASH_DeInit(&hhash_engine);
+      return HAL_TIMEOUT;
+    }
+  }
+
+  return status;
+}
+
+/**
+  * @brief  HASH MSP initialization : GPDMA1 channel 5 (HASH_IN)
+  * @param  hhash HASH handle
+  * @retval None
+  */
+void HAL_HASH_MspInit(HASH_HandleTypeDef *hhash)
+{
+  __HAL_RCC_HASH_CLK_ENABLE();
+  __HAL_RCC_GPDMA1_CLK_ENABLE();
+
+  hdma_hash_in.Instance = GPDMA1_Channel5;
+  hdma_hash_in.Init.Request = GPDMA1_REQUEST_HASH_IN;
+  hdma_hash_in.Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+  hdma_hash_in.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_hash_in.Init.SrcInc = DMA_SINC_INCREMENTED;
+  hdma_hash_in.Init.DestInc = DMA_DINC_FIXED;
+  hdma_hash_in.Init.SrcDataWidth = DMA_SRC_DATAWIDTH_WORD;
+  hdma_hash_in.Init.DestDataWidth = DMA_DEST_DATAWIDTH_WORD;
+  hdma_hash_in.Init.Priority = DMA_LOW_PRIORITY_HIGH_WEIGHT;
+  hdma_hash_in.Init.SrcBurstLength = 1;
+  hdma_hash_in.Init.DestBurstLength = 1;
+  hdma_hash_in.Init.TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0 | DMA_DEST_ALLOCATED_PORT1;
+  hdma_hash_in.Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+  hdma_hash_in.Init.Mode = DMA_NORMAL;
+  if ((HAL_DMA_Init(&hdma_hash_in) != HAL_OK) ||
+      (HAL_DMA_ConfigChannelAttributes(&hdma_hash_in, DMA_CHANNEL_SEC | DMA_CHANNEL_SRC_SEC |
+                                       DMA_CHANNEL_DEST_SEC) != HAL_OK))
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(hhash, hdmain, hdma_hash_in);
+
+  HAL_NVIC_SetPriority(GPDMA1_Channel5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(GPDMA1_Channel5_IRQn);
+}
+
+/**
+  * @brief  HASH MSP de-initialization
+  * @param  hhash HASH handle
+  * @retval None
+  */
+void HAL_HASH_MspDeInit(HASH_HandleTypeDef *hhash)
+{
+  UNUSED(hhash);
+  HAL_NVIC_DisableIRQ(GPDMA1_Channel5_IRQn);
+  (void) HAL_DMA_DeInit(&hdma_hash_in);
+}
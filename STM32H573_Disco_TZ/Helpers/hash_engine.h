@@ -0,0 +1,26 @@
+#ifndef HASH_ENGINE_H
+#define HASH_ENGINE_H
+#include "main.h"
+
+#define HASH_ENGINE_DIGEST_LENGTH (32U)
+#define HASH_ENGINE_DMA_MAX_SIZE  (0xFFFCU)   /* One GPDMA block */
+
+/* SHA256 computation in progress, fed by any number of HashEngine_Update() */
+typedef struct {
+    uint8_t Carry[4];       /* Bytes kept back until the next word or the last block */
+    uint32_t CarryLength;
+    uint32_t Total;
+  } HashEngine_Ctx_t;
+
+HAL_StatusTypeDef HashEngine_Init(HashEngine_Ctx_t *pCtx);
+HAL_StatusTypeDef HashEngine_Update(HashEngine_Ctx_t *pCtx, const void *pData, uint32_t Length);
+HAL_StatusTypeDef HashEngine_Final(HashEngine_Ctx_t *pCtx, uint8_t *pDigest);
+HAL_StatusTypeDef HashEngine_SHA256(const void *pData, uint32_t Length, uint8_t *pDigest);
+HAL_StatusTypeDef HashEngine_StartDMA(const void *pData, uint32_t Length, uint8_t *pDigest);
+HAL_StatusTypeDef HashEngine_PollDMA(void);
+HAL_StatusTypeDef HashEngine_WaitDMA(uint32_t Timeout);
+
+/* GPDMA1 channel feeding HASH, serviced from stm32h5xx_it.c */
+extern DMA_HandleTypeDef hdma_hash_in;
+
+#endif
@@ -0,0 +1,391 @@
+#include "key_store.h"
+#include "perf_timer.h"
+#include "secure_utils.h"
+#include "string.h"
+#include "Keys_Config.h"
+
+#define KEY_STORE_ID_MASK         (0xFF00U)
+
+/* Key of Keys_Config.h */
+typedef struct {
+    uint16_t Id;
+    uint16_t Length;
+    uint32_t Key[KEY_STORE_KEY_MAX_SIZE / 4U];
+  } KeyStore_Config_t;
+
+/* One decrypted key, the GCM record is read and decrypted in place */
+typedef struct {
+    uint32_t Data[OBK_GCM_RECORD_SIZE(KEY_STORE_KEY_MAX_SIZE) / 4U];
+    uint32_t LastUse;     /* Use counter value of the last lookup */
+    uint16_t Id;          /* 0 for a free slot */
+    uint16_t Length;
+  } KeyStore_Slot_t;
+
+static KeyStore_Slot_t Cache[KEY_STORE_CACHE_SIZE];
+static KeyStore_Stats_t Stats;
+static uint32_t UseCounter = 0U;
+
+/* Shared with KeyStore_IdleCallback(), run from SysTick */
+static volatile uint32_t Busy = 0U;
+static volatile uint32_t Cached = 0U;
+static volatile uint32_t LastAccess = 0U;
+
+/**
+  * @brief  Check that an ID belongs to the key store
+  * @param  Id Record ID
+  * @retval 1 for a key store ID, 0 otherwise
+  */
+static uint32_t KeyStore_IsKeyId(uint16_t Id)
+{
+  return ((Id & KEY_STORE_ID_MASK) == OBK_DIR_ID_KEY) ? (1U) : (0U);
+}
+
+/**
+  * @brief  Find a cached key
+  * @param  Id Record ID
+  * @retval Slot holding the key, NULL if it is not cached
+  */
+static KeyStore_Slot_t *KeyStore_Find(uint16_t Id)
+{
+  for (uint32_t i = 0U; i < KEY_STORE_CACHE_SIZE; i++)
+  {
+    if (Cache[i].Id == Id)
+    {
+      return &Cache[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+  * @brief  Zeroize one slot
+  * @param  pSlot Slot
+  * @retval None
+  */
+static void KeyStore_Drop(KeyStore_Slot_t *pSlot)
+{
+  if (pSlot->Id != 0U)
+  {
+    Cached--;
+  }
+  SecureUtils_Zeroize(pSlot, sizeof(KeyStore_Slot_t));
+}
+
+/**
+  * @brief  Read and decrypt a key into the cache
+  * @note   A free slot is used first, the least recently used key is
+  *         evicted otherwise. The GCM tag is checked by the read.
+  * @param  Id Record ID
+  * @param  ppSlot Set to the slot holding the key
+  * @retval PROV_OK, PROV_ERR_STATE if the key is not provisioned,
+  *         PROV_ERR_PARAM for a record larger than KEY_STORE_KEY_MAX_SIZE,
+  *         error status of OBKProvisioning_Read() otherwise
+  */
+static int32_t KeyStore_Load(uint16_t Id, KeyStore_Slot_t **ppSlot)
+{
+  const OBK_DirEntry_t *pEntry = OBKDirectory_Find(Id);
+  KeyStore_Slot_t *pSlot = &Cache[0];
+  int32_t ret;
+
+  if (pEntry == NULL)
+  {
+    return PROV_ERR_STATE;
+  }
+  if ((pEntry->Length <= OBK_GCM_OVERHEAD) || (pEntry->Length > sizeof(pSlot->Data)))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  for (uint32_t i = 0U; i < KEY_STORE_CACHE_SIZE; i++)
+  {
+    if (Cache[i].Id == 0U)
+    {
+      pSlot = &Cache[i];
+      break;
+    }
+    if ((UseCounter - Cache[i].LastUse) > (UseCounter - pSlot->LastUse))
+    {
+      pSlot = &Cache[i];
+    }
+  }
+  if (pSlot->Id != 0U)
+  {
+    Stats.Evictions++;
+  }
+  KeyStore_Drop(pSlot);
+
+  ret = OBKProvisioning_Read(pEntry->Offset, pSlot->Data, pEntry->Length, OBK_RECORD_GCM);
+  if (ret != PROV_OK)
+  {
+    SecureUtils_Zeroize(pSlot, sizeof(KeyStore_Slot_t));
+    return ret;
+  }
+
+  pSlot->Id = Id;
+  pSlot->Length = (uint16_t)(pEntry->Length - OBK_GCM_OVERHEAD);
+  Cached++;
+  *ppSlot = pSlot;
+  return PROV_OK;
+}
+
+/**
+  * @brief  Write a key as a GCM record and register it in the OBK directory
+  * @note   A key already provisioned with this ID is replaced, its cached
+  *         copy is dropped. The record is read back and checked.
+  * @param  Id Key ID, in [OBK_DIR_ID_KEY, OBK_DIR_ID_KEY + 0xFF]
+  * @param  pKey Key (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes, up to KEY_STORE_KEY_MAX_SIZE)
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t KeyStore_Provision(uint16_t Id, const void *pKey, uint32_t Length)
+{
+  KeyStore_Slot_t *pSlot;
+  OBK_Record_t record;
+  int32_t ret;
+
+  if ((pKey == NULL) || (KeyStore_IsKeyId(Id) == 0U) || (Length == 0U) || ((Length % 16U) != 0U) ||
+      (Length > KEY_STORE_KEY_MAX_SIZE))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  ret = OBKDirectory_Allocate(Id, OBK_GCM_RECORD_SIZE(Length), &record.Header);
+  if (ret != PROV_OK)
+  {
+    (void) OBKDirectory_Load();
+    return ret;
+  }
+  record.Header.encrypted = OBK_RECORD_GCM;
+  record.pData = (const uint8_t *)pKey;
+
+  Busy = 1U;
+  pSlot = KeyStore_Find(Id);
+  if (pSlot != NULL)
+  {
+    KeyStore_Drop(pSlot);
+  }
+  Busy = 0U;
+
+  ret = OBKDirectory_Commit(&record, 1U);
+  if (ret == PROV_OK)
+  {
+    ret = OBKProvisioning_VerifyRecords(&record, 1U);
+  }
+  return ret;
+}
+
+/**
+  * @brief  Get a decrypted key, from the cache when possible
+  * @note   The key stays in secure SRAM. The pointer is valid until the next
+  *         key store call or the idle zeroization, copy the key if it must
+  *         outlive them.
+  * @param  Id Key ID
+  * @param  ppKey Set to the decrypted key
+  * @param  pLength Set to the key length in bytes
+  * @retval PROV_OK, PROV_ERR_PARAM for wrong parameters, error status of
+  *         KeyStore_Load() otherwise
+  */
+int32_t KeyStore_Lookup(uint16_t Id, const uint8_t **ppKey, uint32_t *pLength)
+{
+  uint32_t start = PerfTimer_Start();
+  KeyStore_Slot_t *pSlot;
+  uint32_t hit;
+  int32_t ret = PROV_OK;
+
+  if ((ppKey == NULL) || (pLength == NULL) || (KeyStore_IsKeyId(Id) == 0U))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  Busy = 1U;
+  LastAccess = HAL_GetTick();
+
+  pSlot = KeyStore_Find(Id);
+  hit = (pSlot != NULL) ? (1U) : (0U);
+  if (hit == 0U)
+  {
+    ret = KeyStore_Load(Id, &pSlot);
+  }
+
+  if (ret == PROV_OK)
+  {
+    pSlot->LastUse = ++UseCounter;
+    *ppKey = (const uint8_t *)pSlot->Data;
+    *pLength = pSlot->Length;
+  }
+
+  if (hit != 0U)
+  {
+    Stats.Hits++;
+    Stats.LastHitUs = PerfTimer_ElapsedUs(start);
+  }
+  else
+  {
+    Stats.Misses++;
+    Stats.LastMissUs = PerfTimer_ElapsedUs(start);
+  }
+  Busy = 0U;
+
+  return ret;
+}
+
+/**
+  * @brief  Copy a key flagged KEY_STORE_ID_NS to a caller buffer
+  * @param  Id Key ID
+  * @param  pKey Destination buffer
+  * @param  Size Size of the destination buffer
+  * @param  pLength Set to the key length in bytes
+  * @retval PROV_OK, PROV_ERR_PARAM if the key is not exportable or the
+  *         buffer is too small, error status of KeyStore_Lookup() otherwise
+  */
+int32_t KeyStore_Export(uint16_t Id, void *pKey, uint32_t Size, uint32_t *pLength)
+{
+  const uint8_t *p_key;
+  uint32_t length;
+  int32_t ret;
+
+  if ((Id & KEY_STORE_ID_NS) == 0U)
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  ret = KeyStore_Lookup(Id, &p_key, &length);
+  if ((ret == PROV_OK) && (length > Size))
+  {
+    ret = PROV_ERR_PARAM;
+  }
+  if (ret == PROV_OK)
+  {
+    memcpy(pKey, p_key, length);
+    *pLength = length;
+  }
+  return ret;
+}
+
+/**
+  * @brief  Look a key up and compare it with its Keys_Config.h value
+  * @param  pConfig Key
+  * @retval PROV_OK, PROV_ERR_VERIFY if the key differs, error status of
+  *         KeyStore_Lookup() otherwise
+  */
+static int32_t KeyStore_CheckLookup(const KeyStore_Config_t *pConfig)
+{
+  const uint8_t *p_key;
+  uint32_t length;
+  uint8_t diff = 0U;
+  int32_t ret;
+
+  ret = KeyStore_Lookup(pConfig->Id, &p_key, &length);
+  if (ret != PROV_OK)
+  {
+    return ret;
+  }
+  if (length != pConfig->Length)
+  {
+    return PROV_ERR_VERIFY;
+  }
+  for (uint32_t i = 0U; i < length; i++)
+  {
+    diff |= p_key[i] ^ ((const uint8_t *)pConfig->Key)[i];
+  }
+  return (diff == 0U) ? PROV_OK : PROV_ERR_VERIFY;
+}
+
+/**
+  * @brief  Provision the keys of Keys_Config.h and check their lookup
+  * @note   Once written, each key is looked up twice from an empty cache : a
+  *         miss read from OBK then a hit served from the cache, both compared
+  *         with the configured key and counted in the statistics.
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t KeyStore_ProvisionConfig(void)
+{
+#if (KEYS_CONFIG_STORE_COUNT != 0U)
+  static const KeyStore_Config_t config[KEYS_CONFIG_STORE_COUNT] = { KEYS_CONFIG_STORE };
+  uint32_t misses;
+  uint32_t hits;
+  uint32_t i;
+  int32_t ret = PROV_OK;
+
+  for (i = 0U; (i < KEYS_CONFIG_STORE_COUNT) && (ret == PROV_OK); i++)
+  {
+    ret = KeyStore_Provision(config[i].Id, config[i].Key, config[i].Length);
+    PRINTF("Key 0x%04x provisioned : %ld\r\n", config[i].Id, ret);
+  }
+
+  KeyStore_Flush();
+  for (i = 0U; (i < KEYS_CONFIG_STORE_COUNT) && (ret == PROV_OK); i++)
+  {
+    misses = Stats.Misses;
+    hits = Stats.Hits;
+    ret = KeyStore_CheckLookup(&config[i]);
+    if (ret == PROV_OK)
+    {
+      ret = KeyStore_CheckLookup(&config[i]);
+    }
+    if ((ret == PROV_OK) && ((Stats.Misses != (misses + 1U)) || (Stats.Hits != (hits + 1U))))
+    {
+      ret = PROV_ERR_VERIFY;
+    }
+    PRINTF("Key 0x%04x lookup : %ld, miss %lu us, hit %lu us\r\n", config[i].Id, ret, Stats.LastMissUs,
+           Stats.LastHitUs);
+  }
+  KeyStore_Flush();
+
+  return ret;
+#else
+  PRINTF("No key in Keys_Config.h\r\n");
+  return PROV_OK;
+#endif
+}
+
+/**
+  * @brief  Zeroize every cached key
+  * @retval None
+  */
+void KeyStore_Flush(void)
+{
+  Busy = 1U;
+  SecureUtils_Zeroize(Cache, sizeof(Cache));
+  Cached = 0U;
+  Stats.Flushes++;
+  Busy = 0U;
+}
+
+/**
+  * @brief  Zeroize the cache once no key was looked up for KEY_STORE_IDLE_MS
+  * @note   Called from SysTick_Handler, skipped while a lookup is running.
+  * @retval None
+  */
+void KeyStore_IdleCallback(void)
+{
+#if (KEY_STORE_IDLE_MS != 0U)
+  if ((Busy == 0U) && (Cached != 0U) && ((HAL_GetTick() - LastAccess) >= KEY_STORE_IDLE_MS))
+  {
+    KeyStore_Flush();
+  }
+#endif
+}
+
+/**
+  * @brief  Key store counters
+  * @param  pStats Filled with the counters
+  * @retval None
+  */
+void KeyStore_GetStats(KeyStore_Stats_t *pStats)
+{
+  *pStats = Stats;
+}
+
+/**
+  * @brief  Print the key store counters
+  * @retval None
+  */
+void KeyStore_PrintStats(void)
+{
+  PRINTF("Key store : %lu/%lu keys cached\r\n", (uint32_t)Cached, KEY_STORE_CACHE_SIZE);
+  PRINTF("  Hits      : %lu (last %lu us)\r\n", Stats.Hits, Stats.LastHitUs);
+  PRINTF("  Misses    : %lu (last %lu us)\r\n", Stats.Misses, Stats.LastMissUs);
+  PRINTF("  Evictions : %lu\r\n", Stats.Evictions);
+  PRINTF("  Flushes   : %lu\r\n", Stats.Flushes);
+}
@@ -0,0 +1,39 @@
+#ifndef KEY_STORE_H
+#define KEY_STORE_H
+#include "obk_directory.h"
+
+/* Keys are GCM records registered in the OBK directory with an ID in
+   [OBK_DIR_ID_KEY, OBK_DIR_ID_KEY + 0xFF]. IDs with KEY_STORE_ID_NS set
+   can be copied to the non secure side through SECURE_KeyStoreGet(). */
+#define KEY_STORE_ID_NS           (0x0080U)
+
+#ifndef KEY_STORE_CACHE_SIZE
+#define KEY_STORE_CACHE_SIZE      (4U)      /* Decrypted keys kept in secure SRAM */
+#endif
+
+#define KEY_STORE_KEY_MAX_SIZE    (64U)     /* Largest key, multiple of 16 bytes */
+
+/* Cache zeroized when no key was looked up for this long, 0 to disable */
+#ifndef KEY_STORE_IDLE_MS
+#define KEY_STORE_IDLE_MS         (10000U)
+#endif
+
+typedef struct {
+    uint32_t Hits;
+    uint32_t Misses;
+    uint32_t Evictions;   /* Least recently used key dropped for a miss */
+    uint32_t Flushes;     /* Explicit and idle zeroizations */
+    uint32_t LastHitUs;
+    uint32_t LastMissUs;  /* OBK read, SAES decryption and tag check */
+  } KeyStore_Stats_t;
+
+int32_t KeyStore_Provision(uint16_t Id, const void *pKey, uint32_t Length);
+int32_t KeyStore_ProvisionConfig(void);
+int32_t KeyStore_Lookup(uint16_t Id, const uint8_t **ppKey, uint32_t *pLength);
+int32_t KeyStore_Export(uint16_t Id, void *pKey, uint32_t Size, uint32_t *pLength);
+void KeyStore_Flush(void);
+void KeyStore_IdleCallback(void);
+void KeyStore_GetStats(KeyStore_Stats_t *pStats);
+void KeyStore_PrintStats(void);
+
+#endif
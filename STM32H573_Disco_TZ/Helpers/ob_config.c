@@ -0,0 +1,198 @@
+#include "ob_config.h"
+#include "product_state.h"
+#include "prov_result.h"
+
+/**
+  * @brief  Read the option bytes in use
+  * @note   All fields come from the current option registers in one pass,
+  *         the watermarks of both banks included.
+  * @param  pSnapshot Filled with the current configuration
+  * @retval None
+  */
+void OBConfig_Read(OBConfig_Snapshot_t *pSnapshot)
+{
+	uint32_t optsr = FLASH->OPTSR_CUR;
+	uint32_t wm1 = FLASH->SECWM1R_CUR;
+	uint32_t wm2 = FLASH->SECWM2R_CUR;
+
+	pSnapshot->Tzen = FLASH->OPTSR2_CUR & FLASH_OPTSR2_TZEN;
+	pSnapshot->ProductState = optsr & FLASH_OPTSR_PRODUCT_STATE_Msk;
+	pSnapshot->BootUbe = optsr & FLASH_OPTSR_BOOT_UBE_Msk;
+	pSnapshot->Wm1Start = (wm1 & FLASH_SECWMR_SECWM_STRT_Msk) >> FLASH_SECWMR_SECWM_STRT_Pos;
+	pSnapshot->Wm1End = (wm1 & FLASH_SECWMR_SECWM_END_Msk) >> FLASH_SECWMR_SECWM_END_Pos;
+	pSnapshot->Wm2Start = (wm2 & FLASH_SECWMR_SECWM_STRT_Msk) >> FLASH_SECWMR_SECWM_STRT_Pos;
+	pSnapshot->Wm2End = (wm2 & FLASH_SECWMR_SECWM_END_Msk) >> FLASH_SECWMR_SECWM_END_Pos;
+}
+
+/**
+  * @brief  Compare a snapshot with the desired configuration
+  * @param  pSnapshot Current configuration
+  * @param  Fields OB_CONFIG_FIELD_xxx to compare
+  * @retval OB_CONFIG_FIELD_xxx that differ
+  */
+uint32_t OBConfig_Diff(const OBConfig_Snapshot_t *pSnapshot, uint32_t Fields)
+{
+	uint32_t diff = 0U;
+
+	if (pSnapshot->Tzen != OB_CONFIG_TZEN)
+	{
+		diff |= OB_CONFIG_FIELD_TZEN;
+	}
+	if ((pSnapshot->Wm1Start != OB_CONFIG_WM1_START) || (pSnapshot->Wm1End != OB_CONFIG_WM1_END))
+	{
+		diff |= OB_CONFIG_FIELD_WM1;
+	}
+	if ((pSnapshot->Wm2Start != OB_CONFIG_WM2_START) || (pSnapshot->Wm2End != OB_CONFIG_WM2_END))
+	{
+		diff |= OB_CONFIG_FIELD_WM2;
+	}
+	if (pSnapshot->ProductState != OB_CONFIG_PRODUCT_STATE)
+	{
+		diff |= OB_CONFIG_FIELD_PROD;
+	}
+
+	return diff & Fields;
+}
+
+/* Fields to program in one launch, for the retry engine */
+typedef struct {
+    const ProductState_Plan_t *pPlan;
+    uint32_t Diff;
+  } OBConfig_Job_t;
+
+/* An option byte modification left busy or interrupted is retried */
+static const ProvRetry_Policy_t OBConfig_RetryPolicy = PROV_RETRY_FLASH;
+
+/**
+  * @brief  Program the differing fields and launch them, one attempt
+  * @note   Nothing is loaded before the launch, so a failed attempt programs
+  *         the same values again.
+  * @param  pArg OBConfig_Job_t to apply
+  * @retval Result
+  */
+static Prov_Result_t OBConfig_ProgramStep(void *pArg)
+{
+	const OBConfig_Job_t *pJob = (const OBConfig_Job_t *)pArg;
+	FLASH_OBProgramInitTypeDef ob = {0};
+	HAL_StatusTypeDef status = HAL_OK;
+	Prov_Result_t ret = Prov_Ok();
+
+	/* Unlock the Flash to enable the flash control register access */
+	HAL_FLASH_Unlock();
+
+	/* Unlock the Options Bytes */
+	HAL_FLASH_OB_Unlock();
+
+	if ((pJob->Diff & OB_CONFIG_FIELD_TZEN) != 0U)
+	{
+		PRINTF("Program TZEN option byte to 0x%lx\r\n", (uint32_t)OB_CONFIG_TZEN >> FLASH_OPTSR2_TZEN_Pos);
+		ob.OptionType = OPTIONBYTE_USER;
+		ob.USERType = OB_USER_TZEN;
+		ob.USERConfig2 = OB_CONFIG_TZEN;
+		status = HAL_FLASHEx_OBProgram(&ob);
+	}
+
+	if ((status == HAL_OK) && ((pJob->Diff & OB_CONFIG_FIELD_WM1) != 0U))
+	{
+		PRINTF("Program option byte WM Bank1 : Start 0x%2.2lx End 0x%2.2lx\r\n", (uint32_t)OB_CONFIG_WM1_START, (uint32_t)OB_CONFIG_WM1_END);
+		ob.OptionType = OPTIONBYTE_WMSEC;
+		ob.Banks = FLASH_BANK_1;
+		ob.WMSecStartSector = OB_CONFIG_WM1_START;
+		ob.WMSecEndSector = OB_CONFIG_WM1_END;
+		status = HAL_FLASHEx_OBProgram(&ob);
+	}
+
+	if ((status == HAL_OK) && ((pJob->Diff & OB_CONFIG_FIELD_WM2) != 0U))
+	{
+		PRINTF("Program option byte WM Bank2 : Start 0x%2.2lx End 0x%2.2lx\r\n", (uint32_t)OB_CONFIG_WM2_START, (uint32_t)OB_CONFIG_WM2_END);
+		ob.OptionType = OPTIONBYTE_WMSEC;
+		ob.Banks = FLASH_BANK_2;
+		ob.WMSecStartSector = OB_CONFIG_WM2_START;
+		ob.WMSecEndSector = OB_CONFIG_WM2_END;
+		status = HAL_FLASHEx_OBProgram(&ob);
+	}
+
+	if ((status == HAL_OK) && ((pJob->Diff & OB_CONFIG_FIELD_PROD) != 0U))
+	{
+		ob.OptionType = OPTIONBYTE_PROD_STATE;
+		ob.ProductState = pJob->pPlan->Steps[0];
+		PRINTF("Setting product state to 0x%lx ...\r\n", ob.ProductState >> FLASH_OPTSR_PRODUCT_STATE_Pos);
+		status = HAL_FLASHEx_OBProgram(&ob);
+	}
+
+	if (status != HAL_OK)
+	{
+		ret = Prov_Fail(PROV_ERR_OB_PROGRAM, status);
+	}
+	else
+	{
+		/* Single launch for every programmed field */
+		PRINTF("OB Launch ...\r\n");
+		status = HAL_FLASH_OB_Launch();
+		if (status != HAL_OK)
+		{
+			ret = Prov_Fail(PROV_ERR_OB_LAUNCH, status);
+		}
+	}
+
+	HAL_FLASH_OB_Lock();
+	HAL_FLASH_Lock();
+
+	return ret;
+}
+
+/**
+  * @brief  Program the option bytes differing from the desired configuration
+  * @note   The snapshot is read once, only the differing fields are
+  *         programmed and a single OB launch commits them. TZEN is applied
+  *         alone since the watermarks and product state need TrustZone
+  *         enabled; the device resets and the next call applies the rest.
+  *         A product state change also resets the device, one step of the
+  *         planned path per launch. Transient flash errors are retried.
+  * @param  Fields OB_CONFIG_FIELD_xxx to apply
+  * @retval PROV_OK if the configuration is applied, Prov_Status_t otherwise
+  */
+int32_t OBConfig_Apply(uint32_t Fields)
+{
+	OBConfig_Snapshot_t current;
+	ProductState_Plan_t plan;
+	OBConfig_Job_t job = { &plan, 0U };
+	int32_t ret = PROV_OK;
+
+	OBConfig_Read(&current);
+	job.Diff = OBConfig_Diff(&current, Fields);
+	if ((job.Diff & OB_CONFIG_FIELD_TZEN) != 0U)
+	{
+		/* Applied after the TrustZone reset */
+		job.Diff = OB_CONFIG_FIELD_TZEN;
+	}
+
+	if (((job.Diff & OB_CONFIG_FIELD_PROD) != 0U) &&
+	    ((ProductState_Plan(current.ProductState, OB_CONFIG_PRODUCT_STATE, &plan) != PROV_OK) || (ProductState_Check(&plan) != 0U)))
+	{
+		printf("Product state %s cannot be reached\r\n", ProductState_Name(OB_CONFIG_PRODUCT_STATE));
+		job.Diff &= ~OB_CONFIG_FIELD_PROD;
+		ret = PROV_ERR_STATE;
+	}
+
+	if (job.Diff == 0U)
+	{
+		PRINTF("Option bytes already set\r\n");
+		return ret;
+	}
+
+	ret = ProvRetry_Run(&OBConfig_RetryPolicy, "Option bytes", OBConfig_ProgramStep, &job);
+	if (ret != PROV_OK)
+	{
+		return ret;
+	}
+
+	if ((job.Diff & (OB_CONFIG_FIELD_TZEN | OB_CONFIG_FIELD_PROD)) != 0U)
+	{
+		// Reset to have TrustZone or the new product state start
+		PRINTF("Reset...\r\n\r\n");
+		NVIC_SystemReset();
+	}
+
+	return PROV_OK;
+}
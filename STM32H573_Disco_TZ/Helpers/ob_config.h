@@ -0,0 +1,43 @@
+#ifndef OB_CONFIG_H
+#define OB_CONFIG_H
+#include "main.h"
+#include "memory_map.h"
+
+/* Desired option byte configuration */
+#define OB_CONFIG_TZEN            OB_TZEN_ENABLE
+/* Watermarks derived from the linker scripts : only the sectors of the
+   secure image are secure, the rest of bank1 goes to the non secure side */
+#define OB_CONFIG_WM1_START       MEMORY_MAP_WM1_START
+#define OB_CONFIG_WM1_END         MEMORY_MAP_WM1_END
+#define OB_CONFIG_WM2_START       MEMORY_MAP_WM2_START
+#define OB_CONFIG_WM2_END         MEMORY_MAP_WM2_END
+/* OB_PROD_STATE_TZ_CLOSED keeps non secure debug open for failure analysis,
+   with a non secure regression that preserves the secure image and OBK */
+#ifndef OB_CONFIG_PRODUCT_STATE
+#define OB_CONFIG_PRODUCT_STATE   OB_PROD_STATE_CLOSED
+#endif
+
+/* Fields of the configuration */
+#define OB_CONFIG_FIELD_TZEN      (1U << 0)
+#define OB_CONFIG_FIELD_WM1       (1U << 1)
+#define OB_CONFIG_FIELD_WM2       (1U << 2)
+#define OB_CONFIG_FIELD_PROD      (1U << 3)
+#define OB_CONFIG_FIELD_WM        (OB_CONFIG_FIELD_WM1 | OB_CONFIG_FIELD_WM2)
+#define OB_CONFIG_FIELD_ALL       (OB_CONFIG_FIELD_TZEN | OB_CONFIG_FIELD_WM | OB_CONFIG_FIELD_PROD)
+
+/* Option bytes in use, read once from the current option registers */
+typedef struct {
+    uint32_t Tzen;
+    uint32_t ProductState;
+    uint32_t BootUbe;
+    uint32_t Wm1Start;
+    uint32_t Wm1End;
+    uint32_t Wm2Start;
+    uint32_t Wm2End;
+  } OBConfig_Snapshot_t;
+
+void OBConfig_Read(OBConfig_Snapshot_t *pSnapshot);
+uint32_t OBConfig_Diff(const OBConfig_Snapshot_t *pSnapshot, uint32_t Fields);
+int32_t OBConfig_Apply(uint32_t Fields);
+
+#endif
@@ -0,0 +1,414 @@
+#include "obk_directory.h"
+#include "string.h" //For memset
+#include "stdio.h"
+
+/* Copy of the directory record, loaded by a single OBK read */
+static OBK_Directory_t Directory __ALIGNED(4);
+static uint32_t Directory_Loaded = 0U;
+
+/* Records of a commit followed by the directory record */
+static OBK_Record_t CommitRecords[OBK_DIR_MAX_ENTRIES + 1U];
+
+/**
+  * @brief  Round a length up to the OBK programming unit
+  * @param  Length Number of bytes
+  * @retval Rounded length
+  */
+static uint32_t Dir_Align(uint32_t Length)
+{
+  return (Length + 0xFU) & ~0xFU;
+}
+
+/**
+  * @brief  Get the index of an entry
+  * @param  Id Record ID
+  * @retval Index in Directory.Entries, OBK_DIR_MAX_ENTRIES if absent
+  */
+static uint32_t Dir_Index(uint16_t Id)
+{
+  uint32_t i;
+
+  for (i = 0U; i < Directory.Count; i++)
+  {
+    if (Directory.Entries[i].Id == Id)
+    {
+      break;
+    }
+  }
+  return (i < Directory.Count) ? i : OBK_DIR_MAX_ENTRIES;
+}
+
+/**
+  * @brief  Check that a range does not overlap any entry but the one being replaced
+  * @param  Offset Offset from FLASH_OBK_BASE_S
+  * @param  Length Number of bytes
+  * @param  Skip Index of the entry being replaced, OBK_DIR_MAX_ENTRIES for none
+  * @retval 1 if the range is free, 0 otherwise
+  */
+static uint32_t Dir_IsFree(uint32_t Offset, uint32_t Length, uint32_t Skip)
+{
+  for (uint32_t i = 0U; i < Directory.Count; i++)
+  {
+    uint32_t start = Directory.Entries[i].Offset;
+    uint32_t end = start + Dir_Align(Directory.Entries[i].Length);
+
+    if ((i != Skip) && (Offset < end) && (start < (Offset + Length)))
+    {
+      return 0U;
+    }
+  }
+  return 1U;
+}
+
+/**
+  * @brief  Add or update an entry in the RAM copy of the directory
+  * @param  Id Record ID
+  * @param  Offset Offset from FLASH_OBK_BASE_S
+  * @param  Length Number of bytes
+  * @retval PROV_OK, PROV_ERR_STATE if the directory is full
+  */
+static int32_t Dir_Set(uint16_t Id, uint32_t Offset, uint32_t Length)
+{
+  uint32_t i = Dir_Index(Id);
+
+  if (i == OBK_DIR_MAX_ENTRIES)
+  {
+    if (Directory.Count == OBK_DIR_MAX_ENTRIES)
+    {
+      return PROV_ERR_STATE;
+    }
+    i = Directory.Count++;
+    Directory.Entries[i].Id = Id;
+    Directory.Entries[i].Version = 0U;
+  }
+  Directory.Entries[i].Offset = (uint16_t)Offset;
+  Directory.Entries[i].Length = (uint16_t)Length;
+  Directory.Entries[i].Version++;
+
+  return PROV_OK;
+}
+
+/**
+  * @brief  Find the end of the highest non-blank key of HDPL1
+  * @note   Only run once, when the directory is created on a device that may
+  *         hold keys written before the directory existed.
+  * @retval End offset from FLASH_OBK_BASE_S
+  */
+static uint32_t Dir_ScanExtent(void)
+{
+  uint32_t key[4] __ALIGNED(4);
+
+  for (uint32_t offset = OBK_HDPL1_END + 1U - sizeof(key); offset >= OBK_HDPL1_OFFSET; offset -= sizeof(key))
+  {
+    /* A key hit by a double ECC error is counted as used */
+    if ((OBKProvisioning_Read(offset, key, sizeof(key), 0U) != PROV_OK) ||
+        ((key[0] & key[1] & key[2] & key[3]) != 0xFFFFFFFFU))
+    {
+      return offset + sizeof(key);
+    }
+  }
+  return OBK_HDPL1_OFFSET;
+}
+
+/**
+  * @brief  End offset of the keys a bounded swap must carry over
+  * @retval End offset from FLASH_OBK_BASE_S
+  */
+static uint32_t Dir_LiveEnd(void)
+{
+  uint32_t end = Directory.Extent;
+
+  for (uint32_t i = 0U; i < Directory.Count; i++)
+  {
+    uint32_t entry_end = (uint32_t)Directory.Entries[i].Offset + Dir_Align(Directory.Entries[i].Length);
+    end = (entry_end > end) ? entry_end : end;
+  }
+  return end;
+}
+
+/**
+  * @brief  Load the OBK directory
+  * @note   The whole directory is fetched with one OBK read. A device
+  *         provisioned before the directory existed gets its DA record
+  *         registered from the legacy first word check.
+  * @retval PROV_OK, PROV_ERR_VERIFY if the directory record is corrupted,
+  *         error status of OBKProvisioning_Read() otherwise
+  */
+int32_t OBKDirectory_Load(void)
+{
+  int32_t ret = OBKProvisioning_Read(OBK_DIR_OFFSET, &Directory, sizeof(Directory), 0U);
+
+  if (ret != PROV_OK)
+  {
+    memset(&Directory, 0x00, sizeof(Directory));
+    Directory_Loaded = 0U;
+    return ret;
+  }
+
+  if (Directory.Magic == 0xFFFFFFFFU)
+  {
+    /* Never written */
+    memset(&Directory, 0x00, sizeof(Directory));
+    Directory.Magic = OBK_DIR_MAGIC;
+    Directory.Extent = Dir_ScanExtent();
+    if ((*(uint32_t *)(FLASH_OBK_BASE_DA)) != 0xFFFFFFFF)
+    {
+      (void) Dir_Set(OBK_DIR_ID_DA, OBK_HDPL1_OFFSET, OBK_MAX_RECORD_SIZE);
+    }
+  }
+  else if ((Directory.Magic != OBK_DIR_MAGIC) || (Directory.Count > OBK_DIR_MAX_ENTRIES))
+  {
+    memset(&Directory, 0x00, sizeof(Directory));
+    Directory_Loaded = 0U;
+    return PROV_ERR_VERIFY;
+  }
+
+  Directory_Loaded = 1U;
+  return PROV_OK;
+}
+
+/**
+  * @brief  Find a record
+  * @param  Id Record ID
+  * @retval Directory entry, NULL if the record is not provisioned
+  */
+const OBK_DirEntry_t *OBKDirectory_Find(uint16_t Id)
+{
+  uint32_t i;
+
+  if ((Directory_Loaded == 0U) && (OBKDirectory_Load() != PROV_OK))
+  {
+    return NULL;
+  }
+
+  i = Dir_Index(Id);
+  return (i < OBK_DIR_MAX_ENTRIES) ? &Directory.Entries[i] : NULL;
+}
+
+/**
+  * @brief  Record ID of an .obk file placed at a fixed address
+  * @param  Addr Address from the .obk header
+  * @retval Record ID
+  */
+uint16_t OBKDirectory_IdFromAddr(uint32_t Addr)
+{
+  if (Addr == FLASH_OBK_BASE_DA)
+  {
+    return OBK_DIR_ID_DA;
+  }
+  return (uint16_t)(OBK_DIR_ID_ADDR | ((Addr - FLASH_OBK_BASE_S) >> 4U));
+}
+
+/**
+  * @brief  Register a record with a fixed address, to be written by OBKDirectory_Commit()
+  * @param  Id Record ID
+  * @param  pHeader Header of the record
+  * @retval PROV_OK, PROV_ERR_PARAM if the range overlaps another record,
+  *         PROV_ERR_STATE if the directory is full, error status of
+  *         OBKDirectory_Load() otherwise
+  */
+int32_t OBKDirectory_Register(uint16_t Id, const OBK_Header_t *pHeader)
+{
+  uint32_t offset = pHeader->addr - FLASH_OBK_BASE_S;
+  int32_t ret;
+
+  if (Directory_Loaded == 0U)
+  {
+    ret = OBKDirectory_Load();
+    if (ret != PROV_OK)
+    {
+      return ret;
+    }
+  }
+
+  if (Dir_IsFree(offset, pHeader->length, Dir_Index(Id)) == 0U)
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  return Dir_Set(Id, offset, pHeader->length);
+}
+
+/**
+  * @brief  Set the version of a pending entry, to be written by OBKDirectory_Commit()
+  * @note   Entries get the version following the previous one by default.
+  * @param  Id Record ID
+  * @param  Version Version of the record
+  * @retval PROV_OK, PROV_ERR_PARAM if the record is not in the directory
+  */
+int32_t OBKDirectory_SetVersion(uint16_t Id, uint32_t Version)
+{
+  uint32_t i = Dir_Index(Id);
+
+  if ((i == OBK_DIR_MAX_ENTRIES) || (Version > 0xFFFFU))
+  {
+    return PROV_ERR_PARAM;
+  }
+  Directory.Entries[i].Version = (uint16_t)Version;
+  return PROV_OK;
+}
+
+/**
+  * @brief  Place a new record in the free OBK space, to be written by OBKDirectory_Commit()
+  * @note   First fit after the directory record. A record already present is
+  *         placed in a new slot so the current copy stays valid until the swap.
+  * @param  Id Record ID
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pHeader Filled with the address and length of the record
+  * @retval PROV_OK, PROV_ERR_PARAM for a wrong length, PROV_ERR_STATE if
+  *         the directory or the OBK space is full, error status of
+  *         OBKDirectory_Load() otherwise
+  */
+int32_t OBKDirectory_Allocate(uint16_t Id, uint32_t Length, OBK_Header_t *pHeader)
+{
+  uint32_t offset = OBK_DIR_ALLOC_START;
+  int32_t ret;
+
+  if (Directory_Loaded == 0U)
+  {
+    ret = OBKDirectory_Load();
+    if (ret != PROV_OK)
+    {
+      return ret;
+    }
+  }
+
+  if ((Length == 0U) || ((Length % 16U) != 0U))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  /* Move after every entry overlapping the candidate slot */
+  while (Dir_IsFree(offset, Length, OBK_DIR_MAX_ENTRIES) == 0U)
+  {
+    uint32_t next = OBK_HDPL1_END + 1U;
+
+    for (uint32_t i = 0U; i < Directory.Count; i++)
+    {
+      uint32_t start = Directory.Entries[i].Offset;
+      uint32_t end = start + Dir_Align(Directory.Entries[i].Length);
+
+      if ((offset < end) && (start < (offset + Length)) && (end < next))
+      {
+        next = end;
+      }
+    }
+    offset = (next > offset) ? next : (OBK_HDPL1_END + 1U);
+  }
+
+  if ((offset + Length - 1U) > OBK_HDPL1_END)
+  {
+    return PROV_ERR_STATE;
+  }
+
+  ret = Dir_Set(Id, offset, Length);
+  if (ret != PROV_OK)
+  {
+    return ret;
+  }
+
+  pHeader->addr = FLASH_OBK_BASE_S + offset;
+  pHeader->length = Length;
+  return PROV_OK;
+}
+
+/**
+  * @brief  Write records and the updated directory in one OBK cycle
+  * @param  pRecords Records to be programmed
+  * @param  NbRecords Number of records
+  * @param  Bounded 1 to swap only the key slots up to the live records
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+static int32_t Dir_Commit(const OBK_Record_t *pRecords, uint32_t NbRecords, uint32_t Bounded)
+{
+  int32_t ret;
+
+  if ((Directory_Loaded == 0U) || (NbRecords > OBK_DIR_MAX_ENTRIES))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  if (NbRecords != 0U)
+  {
+    memcpy(CommitRecords, pRecords, NbRecords * sizeof(OBK_Record_t));
+  }
+  Directory.Generation++;
+  CommitRecords[NbRecords].Header.addr = FLASH_OBK_BASE_S + OBK_DIR_OFFSET;
+  CommitRecords[NbRecords].Header.length = sizeof(Directory);
+  CommitRecords[NbRecords].Header.encrypted = 0U;
+  CommitRecords[NbRecords].pData = (const uint8_t *)&Directory;
+  Directory.Extent = Dir_LiveEnd();
+
+  if (Bounded != 0U)
+  {
+    ret = OBKProvisioning_WriteRecordsBounded(CommitRecords, NbRecords + 1U, Directory.Extent);
+  }
+  else
+  {
+    ret = OBKProvisioning_WriteRecords(CommitRecords, NbRecords + 1U);
+  }
+  memset(CommitRecords, 0x00, sizeof(CommitRecords));
+
+  if (ret != PROV_OK)
+  {
+    (void) OBKDirectory_Load();
+  }
+  return ret;
+}
+
+/**
+  * @brief  Write records and the updated directory in one OBK cycle
+  * @note   Records must have been registered or allocated first. On error the
+  *         directory is reloaded from OBK, dropping the pending entries.
+  * @param  pRecords Records to be programmed
+  * @param  NbRecords Number of records
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t OBKDirectory_Commit(const OBK_Record_t *pRecords, uint32_t NbRecords)
+{
+  return Dir_Commit(pRecords, NbRecords, OBK_DIR_BOUNDED_SWAP);
+}
+
+/**
+  * @brief  Compare a full and a bounded swap by rewriting the directory
+  * @note   The directory is committed twice with unchanged entries, once
+  *         carrying every key slot over and once up to the live records.
+  *         The bounded pass drops HDPL2/HDPL3 keys, it is only run when
+  *         OBK_DIR_BOUNDED_SWAP allows it.
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t OBKDirectory_SwapBenchmark(void)
+{
+  OBK_WriteTiming_t full;
+  OBK_WriteTiming_t bounded;
+  int32_t ret = OBKDirectory_Load();
+
+  if (ret == PROV_OK)
+  {
+    ret = Dir_Commit(NULL, 0U, 0U);
+  }
+  if (ret != PROV_OK)
+  {
+    return ret;
+  }
+  OBKProvisioning_GetLastTiming(&full);
+
+  printf("OBK swap of 0x%lx keys : %lu us (write cycle %lu us, longest stall %lu us)\r\n", full.SwapOffset,
+         full.SwapUs, full.TotalUs, full.StallUs);
+  if (OBK_DIR_BOUNDED_SWAP == 0U)
+  {
+    printf("Bounded swap disabled (OBK_DIR_BOUNDED_SWAP), keys above HDPL1 are kept\r\n");
+    return PROV_OK;
+  }
+
+  ret = Dir_Commit(NULL, 0U, 1U);
+  if (ret != PROV_OK)
+  {
+    return ret;
+  }
+  OBKProvisioning_GetLastTiming(&bounded);
+
+  printf("OBK swap of 0x%lx keys : %lu us (write cycle %lu us, longest stall %lu us)\r\n", bounded.SwapOffset,
+         bounded.SwapUs, bounded.TotalUs, bounded.StallUs);
+  return PROV_OK;
+}
@@ -0,0 +1,49 @@
+#ifndef OBK_DIRECTORY_H
+#define OBK_DIRECTORY_H
+#include "obk_provisioning.h"
+
+#define OBK_DIR_MAGIC             (0x444B424FU)   /* "OBKD" */
+#define OBK_DIR_MAX_ENTRIES       (16U)
+
+/* Records allocated after the directory, up to OBK_HDPL1_END */
+#define OBK_DIR_ALLOC_START       (OBK_DIR_OFFSET + OBK_DIR_SIZE)
+
+/* Set to 1U to have directory commits swap only the key slots up to the
+   live records. HDPL2/HDPL3 keys are above HDPL1, outside the range read
+   from here, and would be dropped : only enable it when none are used. */
+#ifndef OBK_DIR_BOUNDED_SWAP
+#define OBK_DIR_BOUNDED_SWAP      (0U)
+#endif
+
+#define OBK_DIR_ID_DA             (0x0001U)
+#define OBK_DIR_ID_DA_BACKUP      (0x0002U)       /* Previous DA record, still encrypted */
+#define OBK_DIR_ID_KEY            (0x0100U)       /* Key store GCM records, 0x0100 to 0x01FF */
+#define OBK_DIR_ID_OEM_KEY        (0x0200U)       /* DHUK wrapped OEM keys, 0x0200 to 0x02FF */
+#define OBK_DIR_ID_ADDR           (0x8000U)       /* .obk files, ID built from their address */
+
+typedef struct {
+    uint16_t Id;
+    uint16_t Offset;      /* From FLASH_OBK_BASE_S */
+    uint16_t Length;
+    uint16_t Version;
+  } OBK_DirEntry_t;
+
+/* Layout of the directory record, OBK_DIR_SIZE bytes */
+typedef struct {
+    uint32_t Magic;
+    uint32_t Count;
+    uint32_t Generation;  /* Incremented on each commit */
+    uint32_t Extent;      /* End offset of every key ever written */
+    OBK_DirEntry_t Entries[OBK_DIR_MAX_ENTRIES];
+  } OBK_Directory_t;
+
+int32_t OBKDirectory_Load(void);
+const OBK_DirEntry_t *OBKDirectory_Find(uint16_t Id);
+uint16_t OBKDirectory_IdFromAddr(uint32_t Addr);
+int32_t OBKDirectory_Register(uint16_t Id, const OBK_Header_t *pHeader);
+int32_t OBKDirectory_SetVersion(uint16_t Id, uint32_t Version);
+int32_t OBKDirectory_Allocate(uint16_t Id, uint32_t Length, OBK_Header_t *pHeader);
+int32_t OBKDirectory_Commit(const OBK_Record_t *pRecords, uint32_t NbRecords);
+int32_t OBKDirectory_SwapBenchmark(void);
+
+#endif
@@ -1,34 +1,75 @@
 #include "obk_provisioning.h"
+#include "saes_session.h"
+#include "hash_engine.h"
+#include "obk_directory.h"
+#include "perf_timer.h"
+#include "flash_job.h"
+#include "entropy_pool.h"
+#include "obk_transport.h"
+#include "oem_key.h"
 #include "string.h" //For memcpy
 
 // Debug authentication provisioning data
 #include "DA_Config.h"
 
-#define SHA256_LENGTH             (32U)
-#define OBK_HDPL1_OFFSET          (0x100U)
-#define OBK_HDPL1_END             (0x8FFU)
+/* Version of the embedded DA config, set by ConvertBinToH.py */
+#ifndef DA_CONFIG_VERSION
+#define DA_CONFIG_VERSION         (1U)
+#endif
+
+#define SHA256_LENGTH             OBK_SHA256_LENGTH
 #define OBK_FLASH_PROG_UNIT       (0x10U)
 #define ALL_OBKEYS                (0x1FFU)
+#define OBK_KEY_SIZE              (0x10U)     /* Swap offset unit */
+#define OBK_SAES_DMA_TIMEOUT      (100U)
+#define OBK_FLASH_JOB_TIMEOUT     (1000U)
+#define OBK_RNG_TIMEOUT           (10U)
+
+#define MAX_SIZE_CFG_DA           OBK_MAX_RECORD_SIZE
+
+/* DHUK session shared by the OBK reader and writer */
+static SAES_Session_t ObkSession;
+
+/* Staging buffer holding a whole batch of records before programming */
+static uint32_t OBK_Staging[OBK_HDPL1_SIZE / 4U];
+
+/* Provisioned DA record kept encrypted during a rotation */
+static uint32_t DA_Backup[MAX_SIZE_CFG_DA / 4U];
+
+#ifdef DA_CONFIG_TRANSPORT_KEY_ID
+/* Embedded DA config re-encrypted from the transport key to the DHUK */
+static uint32_t DA_Sealed[MAX_SIZE_CFG_DA / 4U];
+#endif
 
-#define FLASH_OBK_BASE_DA         (FLASH_OBK_BASE_S + OBK_HDPL1_OFFSET)
+/* Timing of the last write cycle */
+static OBK_WriteTiming_t OBK_LastTiming;
 
-#define MAX_SIZE_CFG_DA           0x60
-#define SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH    (1U << SBS_EPOCHSELCR_EPOCH_SEL_Pos)
-#define SBS_EXT_EPOCHSELCR_EPOCH_SEL_NS_EPOCH   (0U << SBS_EPOCHSELCR_EPOCH_SEL_Pos )
+/* Quad-words of the current batch programmed so far */
+static uint32_t OBK_Programmed;
 
+/* Batch handed to the retry engine */
 typedef struct {
-    uint32_t addr;
-    uint32_t length;
-    uint32_t encrypted;
-  } OBK_Header_t;
+    const OBK_Record_t *pRecords;
+    uint32_t NbRecords;
+    uint32_t SwapOffset;
+  } OBK_Batch_t;
 
+/* A busy flash or an interrupted sequence is retried, the batch is rebuilt */
+static const ProvRetry_Policy_t OBK_RetryPolicy = PROV_RETRY_FLASH;
 
-static HASH_HandleTypeDef hhash;
+/* Double ECC error tracking during OBK reads, updated from NMI_Handler */
+static volatile uint32_t DoubleECC_Check = 0U;
+static volatile uint32_t DoubleECC_Error_Counter = 0U;
+static volatile uint32_t DoubleECC_Taken = 0U;
 
 static HAL_StatusTypeDef Compute_SHA256(uint8_t *pBuffer, uint32_t Length, uint8_t *pSHA256);
 static int32_t OBK_Read(uint32_t Offset, void *pData, uint32_t Length);
-static int32_t OBK_Flash_WriteEncrypted(uint32_t Offset, const void *pData, uint32_t Length);
 static int32_t OBK_Flash_ReadEncrypted(uint32_t Offset, void *pData, uint32_t Length);
+static int32_t OBK_Flash_ReadGCM(uint32_t Offset, void *pData, uint32_t Length);
+static HAL_StatusTypeDef Crypto_Acquire(uint32_t *pOwned);
+static Prov_Result_t OBK_WriteBatch(const OBK_Record_t *pRecords, uint32_t NbRecords, uint32_t SwapOffset);
+static Prov_Result_t OBK_WriteBatchStep(void *pArg);
+static void Crypto_Release(uint32_t Owned);
 
 const uint32_t a_aes_iv[4] = {0x8001D1CEU, 0xD1CED1CEU, 0xD1CE8001U, 0xCED1CED1U};
 
@@ -76,28 +117,8 @@ static uint32_t is_write_allowed(uint32_t Length)
   */
 static HAL_StatusTypeDef Compute_SHA256(uint8_t *pBuffer, uint32_t Length, uint8_t *pSHA256)
 {
-  /* Enable HASH clock */
-  __HAL_RCC_HASH_CLK_ENABLE();
-
-  hhash.Instance = HASH;
-  /* HASH Configuration */
-  if (HAL_HASH_DeInit(&hhash) != HAL_OK)
-  {
-    return HAL_ERROR;
-  }
-  hhash.Init.DataType = HASH_BYTE_SWAP;
-  hhash.Init.Algorithm = HASH_ALGOSELECTION_SHA256;
-  if (HAL_HASH_Init(&hhash) != HAL_OK)
-  {
-    return HAL_ERROR;
-  }
-
-  /* HASH computation */
-  if (HAL_HASH_Start(&hhash, pBuffer, Length, pSHA256, 10) != HAL_OK)
-  {
-    return HAL_ERROR;
-  }
-  return HAL_OK;
+  /* Hashed block by block, any length */
+  return HashEngine_SHA256(pBuffer, Length, pSHA256);
 }
 
 /**
@@ -120,207 +141,920 @@ static uint32_t MemoryCompare(uint8_t *pAdd1, uint8_t *pAdd2, uint32_t Size)
   return result;
 }
 
+/**
+  * @brief  Open the OBK DHUK session for a sequence of OBK accesses
+  * @note   Until OBKProvisioning_CloseCryptoSession() is called, every OBK
+  *         encrypt/decrypt reuses the same SAES configuration and DHUK load.
+  * @retval PROV_OK, PROV_ERR_CRYPTO if the session could not be opened
+  */
+int32_t OBKProvisioning_OpenCryptoSession(void)
+{
+  if (ObkSession.State != SAES_SESSION_CLOSED)
+  {
+    return PROV_OK;
+  }
+  if (SAESSession_Open(&ObkSession, a_aes_iv) != HAL_OK)
+  {
+    SAESSession_Close(&ObkSession);
+    return PROV_ERR_CRYPTO;
+  }
+  return PROV_OK;
+}
 
 /**
-  * @brief  Write encrypted OBkeys
-  * @param  Offset Offset in the OBKeys area (aligned on 16 bytes)
-  * @param  pData Data buffer to be programmed encrypted (aligned on 4 bytes)
-  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @brief  Close the OBK DHUK session and zeroize its context
+  * @retval None
+  */
+void OBKProvisioning_CloseCryptoSession(void)
+{
+  SAESSession_Close(&ObkSession);
+}
+
+/**
+  * @brief  Suspend the OBK DHUK session before another module uses SAES
+  * @note   The next OBK access configures SAES with the DHUK again.
+  * @retval PROV_OK, PROV_ERR_STATE if no session is open
+  */
+int32_t OBKProvisioning_SuspendCryptoSession(void)
+{
+  return (SAESSession_Suspend(&ObkSession) == HAL_OK) ? PROV_OK : PROV_ERR_STATE;
+}
+
+/**
+  * @brief  Get the OBK DHUK session, opening it for a single access if needed
+  * @param  pOwned Set to 1 when the session was opened here
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef Crypto_Acquire(uint32_t *pOwned)
+{
+  *pOwned = 0U;
+  if (ObkSession.State == SAES_SESSION_OPEN)
+  {
+    return HAL_OK;
+  }
+  if (ObkSession.State == SAES_SESSION_SUSPENDED)
+  {
+    return SAESSession_Resume(&ObkSession);
+  }
+  if (OBKProvisioning_OpenCryptoSession() != PROV_OK)
+  {
+    return HAL_ERROR;
+  }
+  *pOwned = 1U;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Close the OBK DHUK session if it was opened for a single access
+  * @param  Owned Value returned by Crypto_Acquire()
+  * @retval None
+  */
+static void Crypto_Release(uint32_t Owned)
+{
+  if (Owned != 0U)
+  {
+    OBKProvisioning_CloseCryptoSession();
+  }
+}
+
+/**
+  * @brief  Check that a list of records fits in the OBKeys area without overlap
+  * @param  pRecords Records to be programmed
+  * @param  NbRecords Number of records
+  * @retval 1 if the list can be programmed, 0 otherwise
+  */
+static uint32_t is_batch_valid(const OBK_Record_t *pRecords, uint32_t NbRecords)
+{
+  uint32_t total = 0U;
+
+  for (uint32_t i = 0U; i < NbRecords; i++)
+  {
+    uint32_t offset = pRecords[i].Header.addr - FLASH_OBK_BASE_S;
+    uint32_t length = pRecords[i].Header.length;
+
+    if ((pRecords[i].Header.addr < FLASH_OBK_BASE_S) ||
+        (length == 0U) ||
+        (is_range_valid(offset + length - 1U) != 1) ||
+        (is_write_aligned(offset) != 1) ||
+        (is_write_allowed(length) != 1) ||
+        ((pRecords[i].Header.encrypted == OBK_RECORD_GCM) && (length <= OBK_GCM_OVERHEAD)))
+    {
+      return 0;
+    }
+
+    /* Records must not overlap, the ALT sector is programmed only once */
+    for (uint32_t j = 0U; j < i; j++)
+    {
+      uint32_t other = pRecords[j].Header.addr - FLASH_OBK_BASE_S;
+      if ((offset < (other + pRecords[j].Header.length)) && (other < (offset + length)))
+      {
+        return 0;
+      }
+    }
+
+    total += length;
+  }
+
+  return (total <= sizeof(OBK_Staging)) ? (1) : (0);
+}
+
+/**
+  * @brief  Write a batch of OBkeys records in a single erase/program/swap cycle
+  * @note   All encrypted records are processed by SAES with the same DHUK
+  *         configuration, then the ALT sector is erased once, every record is
+  *         programmed into it and a single swap commits the whole batch.
+  *         Every key slot is carried over by the swap.
+  * @param  pRecords Records to be programmed (payload aligned on 4 bytes)
+  * @param  NbRecords Number of records
   * @retval error status
   */
-static int32_t OBK_Flash_WriteEncrypted(uint32_t Offset, const void *pData, uint32_t Length)
+int32_t OBKProvisioning_WriteRecords(const OBK_Record_t *pRecords, uint32_t NbRecords)
 {
-  uint32_t i = 0U;
-  uint32_t destination = FLASH_OBK_BASE_S + Offset;
-  FLASH_EraseInitTypeDef FLASH_EraseInitStruct = {0U};
-  uint32_t sector_error = 0U;
-  CRYP_HandleTypeDef hcryp = {0U};
-  uint32_t SaesTimeout = 100U;
-  uint32_t DataEncrypted[MAX_SIZE_CFG_DA / 4U] = {0UL};
+  OBK_Batch_t batch = { pRecords, NbRecords, ALL_OBKEYS };
 
-  /* Check parameters */
-  if ((is_range_valid(Offset + Length - 1U) != 1) ||
-      (is_write_aligned(Offset) != 1) ||
-      (is_write_allowed(Length) != 1) ||
-      (Length > MAX_SIZE_CFG_DA))
+  return ProvRetry_Run(&OBK_RetryPolicy, "OBK write", OBK_WriteBatchStep, &batch);
+}
+
+/**
+  * @brief  Write a batch of OBkeys records, swapping only the used key slots
+  * @note   The swap copies the keys not programmed in the ALT sector from the
+  *         current one, for key slots below the swap offset only. The offset
+  *         is set to the end of the batch or of the live records, whichever
+  *         is higher, so an update early in the area copies fewer keys.
+  *         Keys above LiveEnd are lost, including HDPL2/HDPL3 keys.
+  * @param  pRecords Records to be programmed (payload aligned on 4 bytes)
+  * @param  NbRecords Number of records
+  * @param  LiveEnd End offset of the records to keep, from FLASH_OBK_BASE_S
+  * @retval error status
+  */
+int32_t OBKProvisioning_WriteRecordsBounded(const OBK_Record_t *pRecords, uint32_t NbRecords, uint32_t LiveEnd)
+{
+  uint32_t end = LiveEnd;
+
+  for (uint32_t r = 0U; (pRecords != NULL) && (r < NbRecords); r++)
   {
-    return 1;
+    uint32_t record_end = pRecords[r].Header.addr - FLASH_OBK_BASE_S + pRecords[r].Header.length;
+    end = (record_end > end) ? record_end : end;
   }
 
-  __HAL_RCC_SBS_CLK_ENABLE();
-  __HAL_RCC_SAES_CLK_ENABLE();
+  /* HDPL0 keys are always kept */
+  end = (end > (FLASH_OBK_SWAP_OFFSET_HDPL0 * OBK_KEY_SIZE)) ? end : (FLASH_OBK_SWAP_OFFSET_HDPL0 * OBK_KEY_SIZE);
+  if (end > (OBK_HDPL1_END + 1U))
+  {
+    return PROV_ERR_PARAM;
+  }
 
-  /* Unlock  Flash area */
-  (void) HAL_FLASH_Unlock();
-  (void) HAL_FLASHEx_OBK_Unlock();
+  OBK_Batch_t batch = { pRecords, NbRecords, (end + OBK_KEY_SIZE - 1U) / OBK_KEY_SIZE };
+  return ProvRetry_Run(&OBK_RetryPolicy, "OBK write", OBK_WriteBatchStep, &batch);
+}
+
+/**
+  * @brief  Timing of the last OBK write cycle
+  * @param  pTiming Filled with the durations and the swap offset used
+  * @retval None
+  */
+void OBKProvisioning_GetLastTiming(OBK_WriteTiming_t *pTiming)
+{
+  *pTiming = OBK_LastTiming;
+}
 
-  /* Force use of EPOCH_S value for DHUK */
-  WRITE_REG(SBS_S->EPOCHSELCR, SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH);
+/**
+  * @brief  Queue a flash job, waiting for a free slot
+  * @param  pJob Job
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef OBK_SubmitJob(const FlashJob_t *pJob)
+{
+  uint32_t tickstart = HAL_GetTick();
+  HAL_StatusTypeDef status;
 
-  /* Configure SAES parameters */
-  hcryp.Instance = SAES_S;
-  if (HAL_CRYP_DeInit(&hcryp) != HAL_OK)
+  while ((status = FlashJob_Submit(pJob)) == HAL_BUSY)
   {
-    return 2;
+    if ((HAL_GetTick() - tickstart) > OBK_FLASH_JOB_TIMEOUT)
+    {
+      return HAL_TIMEOUT;
+    }
+    FlashJob_IdleCallback();
+    FlashJob_Poll();
   }
-  hcryp.Init.DataType = CRYP_NO_SWAP;
-  hcryp.Init.KeySelect = CRYP_KEYSEL_HW;        /* Hardware key : derived hardware unique key (DHUK 256-bit) */
-  hcryp.Init.Algorithm = CRYP_AES_CBC;
-  hcryp.Init.KeyMode = CRYP_KEYMODE_NORMAL ;
-  hcryp.Init.KeySize = CRYP_KEYSIZE_256B;       /* 256 bits AES Key */
-  hcryp.Init.pInitVect = (uint32_t *)a_aes_iv;
 
-  if (HAL_CRYP_Init(&hcryp) != HAL_OK)
+  return status;
+}
+
+/**
+  * @brief  Keep the first failure of a batch
+  * @param  pContext Prov_Result_t of the batch
+  * @param  pResult Result of the job
+  * @param  ElapsedUs Duration of the job
+  * @retval None
+  */
+static void OBK_JobDone(void *pContext, const Prov_Result_t *pResult, uint32_t ElapsedUs)
+{
+  Prov_Result_t *pBatch = (Prov_Result_t *)pContext;
+
+  UNUSED(ElapsedUs);
+  if ((pResult->Status != PROV_OK) && (pBatch->Status == PROV_OK))
   {
-    return 3;
+    *pBatch = *pResult;
   }
+}
+
+/**
+  * @brief  End of the OBK swap, timed for OBKProvisioning_GetLastTiming()
+  * @param  pContext Prov_Result_t of the batch
+  * @param  pResult Result of the swap
+  * @param  ElapsedUs Duration of the swap
+  * @retval None
+  */
+static void OBK_SwapDone(void *pContext, const Prov_Result_t *pResult, uint32_t ElapsedUs)
+{
+  OBK_LastTiming.SwapUs = ElapsedUs;
+  OBK_JobDone(pContext, pResult, ElapsedUs);
+}
 
-  /* Size is n words */
-  if (HAL_CRYP_Encrypt(&hcryp, (uint32_t *)pData, (uint16_t) (Length / 4U), &DataEncrypted[0U], SaesTimeout) != HAL_OK)
+/**
+  * @brief  Progress of a record being programmed
+  * @note   Only counted here, the batch reports it once the swap is done so
+  *         that the console does not lengthen the flash wait.
+  * @param  pContext Prov_Result_t of the batch
+  * @param  Done Quad-words programmed
+  * @param  Total Quad-words of the record
+  * @retval None
+  */
+static void OBK_JobProgress(void *pContext, uint32_t Done, uint32_t Total)
+{
+  UNUSED(pContext);
+  if (Done == Total)
   {
-    return 4;
+    OBK_Programmed += Total;
   }
-  if (HAL_CRYP_DeInit(&hcryp) != HAL_OK)
+}
+
+/**
+  * @brief  Encrypt a GCM record into the staging buffer
+  * @note   A fresh IV is drawn from the entropy pool for every write, the record
+  *         address and length are authenticated with the payload so a record
+  *         copied to another slot fails its tag check.
+  * @param  pRecord Record with a GCM header
+  * @param  pStaged Destination, Header length bytes
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef OBK_EncryptGCM(const OBK_Record_t *pRecord, uint32_t *pStaged)
+{
+  uint32_t aad[2] = { pRecord->Header.addr, pRecord->Header.length };
+
+  if (EntropyPool_GetTimeout(pStaged, 3U * 4U, OBK_RNG_TIMEOUT) != PROV_OK)
   {
-    return 5;
+    return HAL_ERROR;
   }
+  pStaged[3] = OBK_GCM_MARKER;
 
-  /* Erase OBKeys */
-  FLASH_EraseInitStruct.TypeErase = FLASH_TYPEERASE_OBK_ALT;
-  if (HAL_FLASHEx_Erase(&FLASH_EraseInitStruct, &sector_error) != HAL_OK)
+  return SAESSession_EncryptGCM(&ObkSession, pStaged, aad, 2U, pRecord->pData,
+                                pRecord->Header.length - OBK_GCM_OVERHEAD, &pStaged[OBK_GCM_OVERHEAD / 4U],
+                                &pStaged[4]);
+}
+
+/**
+  * @brief  Wait for the DMA encryption of a record
+  * @note   The flash jobs already queued keep running meanwhile, their
+  *         completions are reported from here.
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef OBK_WaitEncryptDMA(void)
+{
+  uint32_t tickstart = HAL_GetTick();
+  HAL_StatusTypeDef status;
+
+  while ((status = SAESSession_PollDMA(&ObkSession)) == HAL_BUSY)
   {
-    return 6;
+    if ((HAL_GetTick() - tickstart) > OBK_SAES_DMA_TIMEOUT)
+    {
+      SAESSession_AbortDMA(&ObkSession);
+      return HAL_TIMEOUT;
+    }
+    FlashJob_IdleCallback();
+    FlashJob_Poll();
   }
 
-  /* Program OBKeys */
-  for (i = 0U; i < Length; i += OBK_FLASH_PROG_UNIT)
+  return status;
+}
+
+/**
+  * @brief  Encrypt, program and swap a batch of OBkeys records
+  * @note   The alternate sector is erased while the first record is
+  *         encrypted, and each record is queued for programming as soon as
+  *         it is staged, so the encryption of a record overlaps the erase or
+  *         the programming of the previous ones.
+  * @param  pRecords Records to be programmed (payload aligned on 4 bytes)
+  * @param  NbRecords Number of records
+  * @param  SwapOffset Number of key slots carried over by the swap
+  * @retval Result, with the flash error detail on failure
+  */
+static Prov_Result_t OBK_WriteBatch(const OBK_Record_t *pRecords, uint32_t NbRecords, uint32_t SwapOffset)
+{
+  uint32_t r = 0U;
+  uint32_t staged = 0U;
+  FlashJob_t job = {0U};
+  uint32_t owned = 0U;
+  uint32_t start;
+  HAL_StatusTypeDef status;
+  Prov_Result_t ret = Prov_Ok();
+
+  /* Check parameters */
+  if ((pRecords == NULL) || (NbRecords == 0U) || (is_batch_valid(pRecords, NbRecords) != 1))
+  {
+    return Prov_Fail(PROV_ERR_PARAM, HAL_OK);
+  }
+
+  start = PerfTimer_Start();
+
+  /* Same DHUK session for the whole batch, each CBC record restarts from a_aes_iv */
+  status = Crypto_Acquire(&owned);
+  if (status != HAL_OK)
+  {
+    return Prov_Fail(PROV_ERR_CRYPTO, status);
+  }
+
+  /* Unlock  Flash area */
+  (void) HAL_FLASH_Unlock();
+  (void) HAL_FLASHEx_OBK_Unlock();
+
+  /* Erase, program and swap run from the flash interrupt */
+  OBK_LastTiming.SwapUs = 0U;
+  OBK_Programmed = 0U;
+  job.pDone = OBK_JobDone;
+  job.pContext = &ret;
+  job.Operation = FLASH_JOB_ERASE_OBK;
+  status = OBK_SubmitJob(&job);
+  if (status != HAL_OK)
   {
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_QUADWORD_OBK_ALT, (destination + i), (uint32_t)&DataEncrypted[i / 4U]) != HAL_OK)
+    ret = Prov_Fail(PROV_ERR_FLASH_ERASE, status);
+  }
+
+  /* Encrypt every record into the staging buffer and queue its programming */
+  job.Operation = FLASH_JOB_PROGRAM_OBK;
+  job.pProgress = OBK_JobProgress;
+  for (r = 0U; (r < NbRecords) && (ret.Status == PROV_OK); r++)
+  {
+    uint32_t length = pRecords[r].Header.length;
+
+    if (pRecords[r].Header.encrypted == OBK_RECORD_GCM)
+    {
+      status = OBK_EncryptGCM(&pRecords[r], &OBK_Staging[staged / 4U]);
+    }
+    else if ((pRecords[r].Header.encrypted != OBK_RECORD_PLAIN) &&
+             (pRecords[r].Header.encrypted != OBK_RECORD_CBC_SEALED))
+    {
+      /* GPDMA1 feeds SAES straight from the caller's buffer */
+      status = SAESSession_EncryptDMA(&ObkSession, pRecords[r].pData, length, &OBK_Staging[staged / 4U]);
+      if (status == HAL_OK)
+      {
+        status = OBK_WaitEncryptDMA();
+      }
+    }
+    else
+    {
+      memcpy(&OBK_Staging[staged / 4U], pRecords[r].pData, length);
+      status = HAL_OK;
+    }
+    if (status != HAL_OK)
+    {
+      if (ret.Status == PROV_OK)
+      {
+        ret = Prov_Fail(PROV_ERR_CRYPTO, status);
+      }
+      break;
+    }
+
+    job.Address = pRecords[r].Header.addr;
+    job.pData = &OBK_Staging[staged / 4U];
+    job.Count = length / OBK_FLASH_PROG_UNIT;
+    status = OBK_SubmitJob(&job);
+    if (status != HAL_OK)
     {
-      return 7;
+      if (ret.Status == PROV_OK)
+      {
+        ret = Prov_Fail(PROV_ERR_FLASH_PROGRAM, status);
+      }
+      break;
     }
+    staged += length;
+  }
+
+  Crypto_Release(owned);
+
+  /* Swap OBKeys once for the whole batch, only if every record is queued */
+  job.Operation = FLASH_JOB_SWAP_OBK;
+  job.Count = SwapOffset;
+  job.pProgress = NULL;
+  job.pDone = OBK_SwapDone;
+  if (ret.Status == PROV_OK)
+  {
+    status = OBK_SubmitJob(&job);
   }
 
-  /* Swap all OBKeys */
-  if (HAL_FLASHEx_OBK_Swap(ALL_OBKEYS) != HAL_OK)
+  if (FlashJob_Wait(OBK_FLASH_JOB_TIMEOUT) != HAL_OK)
   {
-      return 8;
+    status = HAL_TIMEOUT;
+  }
+  OBK_LastTiming.StallUs = FlashJob_GetMaxStallUs();
+  if ((status != HAL_OK) && (ret.Status == PROV_OK))
+  {
+    ret = Prov_Fail(PROV_ERR_FLASH_PROGRAM, status);
   }
 
   /* Lock the User Flash area */
   (void) HAL_FLASH_Lock();
   (void) HAL_FLASHEx_OBK_Lock();
 
-  return 0;
+  memset(OBK_Staging, 0x00, sizeof(OBK_Staging));
+
+  OBK_LastTiming.TotalUs = PerfTimer_ElapsedUs(start);
+  OBK_LastTiming.SwapOffset = SwapOffset;
+
+  PRINTF("OBK programmed %lu/%lu quad-words\r\n", OBK_Programmed, staged / OBK_FLASH_PROG_UNIT);
+
+  return ret;
+}
+
+/**
+  * @brief  One attempt of a batch write, for ProvRetry_Run()
+  * @note   A failed attempt leaves the current OBK sector untouched until the
+  *         swap, so the whole cycle is simply run again.
+  * @param  pArg OBK_Batch_t to write
+  * @retval Result
+  */
+static Prov_Result_t OBK_WriteBatchStep(void *pArg)
+{
+  const OBK_Batch_t *pBatch = (const OBK_Batch_t *)pArg;
+
+  return OBK_WriteBatch(pBatch->pRecords, pBatch->NbRecords, pBatch->SwapOffset);
+}
+
+/**
+  * @brief  FLASH double ECC error, from HAL_FLASHEx_ECCD_IRQHandler() in NMI_Handler
+  * @note   While an OBK read is in progress the error is only counted so that
+  *         the reader can discard the affected quad-word instead of faulting.
+  *         The HAL clears ECCD once this callback returns.
+  * @retval None
+  */
+void HAL_FLASHEx_EccDetectionCallback(void)
+{
+  if ((DoubleECC_Check != 0U) && ((FLASH->ECCDETR & FLASH_ECCR_OBK_ECC) != 0U))
+  {
+    DoubleECC_Error_Counter++;
+    DoubleECC_Taken = 1U;
+  }
+}
+
+/**
+  * @brief  Tell whether the last double ECC error hit a guarded OBK read
+  * @note   Called in NMI_Handler after HAL_FLASHEx_ECCD_IRQHandler().
+  * @retval 1 if the NMI was caused by a guarded OBK read, 0 otherwise
+  */
+uint32_t OBKProvisioning_DoubleECC_Taken(void)
+{
+  uint32_t taken = DoubleECC_Taken;
+
+  DoubleECC_Taken = 0U;
+  return taken;
 }
 
 /**
   * @brief  Read non-encrypted OBkeys
+  * @note   Copy is done by words at bus speed, one quad-word (OBK ECC unit)
+  *         at a time. A quad-word hit by a double ECC error is zeroed and
+  *         reported, the remaining ones are still read.
   * @param  Offset: Offset in the OBKeys area (aligned on 16 bytes)
   * @param  pData Data buffer to be filled (aligned on 4 bytes)
   * @param  Length: Number of bytes (multiple of 4 bytes)
-  * @retval ARM_DRIVER error status
+  * @retval PROV_OK, PROV_ERR_PARAM for wrong parameters, PROV_ERR_VERIFY on
+  *         double ECC error
   */
 static int32_t OBK_Read(uint32_t Offset, void *pData, uint32_t Length)
 {
-  uint32_t *p_source = (uint32_t *) (FLASH_OBK_BASE_S + Offset);
+  volatile uint32_t *p_source = (volatile uint32_t *) (FLASH_OBK_BASE_S + Offset);
   uint32_t *p_destination = (uint32_t *) pData;
+  uint32_t nb_words = Length / 4U;
+  int32_t ret = PROV_OK;
 
   /* Check parameters */
-  if (is_range_valid(Offset + Length - 1U) != 1)
+  if ((Length == 0U) || ((Length % 4U) != 0U) ||
+      (is_write_aligned(Offset) != 1) || (is_range_valid(Offset + Length - 1U) != 1))
   {
-    return 1;
+    return PROV_ERR_PARAM;
   }
 
-  for (uint32_t i=0; i<(Length/4); i++)
+  /* Do not use memcpy from lib to manage properly ECC error */
+  DoubleECC_Check = 1U;
+  for (uint32_t i = 0U; i < nb_words; i += (OBK_FLASH_PROG_UNIT / 4U))
   {
-	  *(p_destination+i) = *(p_source+i);
-	  HAL_Delay(10);
+    uint32_t n = ((nb_words - i) < (OBK_FLASH_PROG_UNIT / 4U)) ? (nb_words - i) : (OBK_FLASH_PROG_UNIT / 4U);
+
+    DoubleECC_Error_Counter = 0U;
+    for (uint32_t j = 0U; j < n; j++)
+    {
+      p_destination[i + j] = p_source[i + j];
+    }
+    __DSB();
+
+    if (DoubleECC_Error_Counter != 0U)
+    {
+      PRINTF("Double ECC error detected at 0x%lx\r\n", (uint32_t)&p_source[i]);
+      memset(&p_destination[i], 0x00, n * 4U);
+      ret = PROV_ERR_VERIFY;
+    }
   }
+  DoubleECC_Check = 0U;
 
-  return 0;
+  return ret;
 }
 
 
 /**
   * @brief  Read encrypted OBkeys
+  * @note   The encrypted data is read into pData then decrypted in place by
+  *         SAES through GPDMA1, any length up to the whole HDPL1 area. The
+  *         caller needs the plain data, so the transfer is waited for : DMA
+  *         saves the word-by-word CPU feed, it does not overlap other work.
   * @param  Offset Offset in the OBKeys area (aligned on 16 bytes)
   * @param  pData Data buffer to be filled (aligned on 4 bytes)
-  * @param  Length Number of bytes (multiple of 4 bytes)
-  * @retval ARM_DRIVER error status
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @retval PROV_OK, PROV_ERR_CRYPTO on SAES error, error status of
+  *         OBK_Read() otherwise
   */
 static int32_t OBK_Flash_ReadEncrypted(uint32_t Offset, void *pData, uint32_t Length)
 {
-  CRYP_HandleTypeDef hcryp = { 0U };
-  uint32_t SaesTimeout = 100U;
-  uint32_t DataEncrypted[MAX_SIZE_CFG_DA / 4U] = { 0UL };
-  uint8_t *p_source = (uint8_t *) (FLASH_OBK_BASE_S + Offset);
-  uint8_t *p_destination = (uint8_t *) DataEncrypted;
+  uint32_t owned = 0U;
+  int32_t ret;
+
   /* Check OBKeys  boundaries */
-  if (is_range_valid(Offset + Length -1U) != 1)
+  if (is_write_allowed(Length) != 1)
   {
-    return 1;
+    return PROV_ERR_PARAM;
   }
 
-  /* Do not use memcpy from lib to manage properly ECC error */
-  //DoubleECC_Error_Counter = 0U;
-  memcpy(p_destination, p_source, Length);
-//  if (DoubleECC_Error_Counter != 0U)
-//  {
-//    BOOT_LOG_ERR("Double ECC error detected: FLASH_ECCDETR=0x%x", (int)FLASH->ECCDETR);
-//    memset(p_destination, 0x00, Length);
-//  }
+  /* CPU copy keeps the double ECC protection of OBK_Read */
+  ret = OBK_Read(Offset, pData, Length);
+  if (ret == PROV_ERR_PARAM)
+  {
+    return ret;
+  }
+  if (ret != PROV_OK)
+  {
+    /* Do not decrypt data corrupted by a double ECC error */
+    memset(pData, 0x00, Length);
+    return ret;
+  }
 
-  __HAL_RCC_SBS_CLK_ENABLE();
-  __HAL_RCC_SAES_CLK_ENABLE();
+  /* Reuse the DHUK session when the caller opened one */
+  if (Crypto_Acquire(&owned) != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
 
-  /* Force use of EPOCH_S value for DHUK */
-  WRITE_REG(SBS_S->EPOCHSELCR, SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH);
+  if ((SAESSession_DecryptDMA(&ObkSession, pData, Length, pData) != HAL_OK) ||
+      (SAESSession_WaitDMA(&ObkSession, OBK_SAES_DMA_TIMEOUT) != HAL_OK))
+  {
+    /* Do not leave encrypted data in the caller's buffer */
+    memset(pData, 0x00, Length);
+    ret = PROV_ERR_CRYPTO;
+  }
+
+  Crypto_Release(owned);
 
-  /* Configure SAES parameters */
-  hcryp.Instance = SAES_S;
-  if (HAL_CRYP_DeInit(&hcryp) != HAL_OK)
+  return ret;
+}
+
+/**
+  * @brief  Read and authenticate a GCM record
+  * @note   The tag is computed while the payload is decrypted, a single SAES
+  *         pass replaces the CBC decryption plus SHA256 check. The payload is
+  *         moved to the start of pData, nothing is returned on a tag mismatch.
+  * @param  Offset Offset in the OBKeys area (aligned on 16 bytes)
+  * @param  pData Data buffer of Length bytes (aligned on 4 bytes)
+  * @param  Length Stored record size (multiple of 16 bytes)
+  * @retval PROV_OK, PROV_ERR_VERIFY on authentication failure or double ECC
+  *         error, PROV_ERR_STATE if no GCM record is stored there,
+  *         PROV_ERR_PARAM for wrong parameters, PROV_ERR_CRYPTO on SAES error
+  */
+static int32_t OBK_Flash_ReadGCM(uint32_t Offset, void *pData, uint32_t Length)
+{
+  uint32_t *p_record = (uint32_t *)pData;
+  uint32_t aad[2] = { FLASH_OBK_BASE_S + Offset, Length };
+  uint32_t iv[3];
+  uint32_t tag[4];
+  uint32_t owned = 0U;
+  int32_t ret;
+
+  if ((Length <= OBK_GCM_OVERHEAD) || (is_write_allowed(Length) != 1))
   {
-    return 2;
+    return PROV_ERR_PARAM;
   }
-  hcryp.Init.DataType  = CRYP_NO_SWAP;
-  hcryp.Init.KeySelect = CRYP_KEYSEL_HW;  /* Hardware unique key (256-bits) */
-  hcryp.Init.Algorithm = CRYP_AES_CBC;
-  hcryp.Init.KeyMode = CRYP_KEYMODE_NORMAL ;
-  hcryp.Init.KeySize = CRYP_KEYSIZE_256B; /* 256 bits AES Key*/
-  hcryp.Init.pInitVect = (uint32_t *)a_aes_iv;
 
-  if (HAL_CRYP_Init(&hcryp) != HAL_OK)
+  ret = OBK_Read(Offset, pData, Length);
+  if (ret == PROV_ERR_PARAM)
   {
-    return 3;
+    return ret;
   }
+  if ((ret != PROV_OK) || (p_record[3] != OBK_GCM_MARKER))
+  {
+    memset(pData, 0x00, Length);
+    return (ret != PROV_OK) ? ret : PROV_ERR_STATE;
+  }
+  memcpy(iv, p_record, sizeof(iv));
 
-  /*Size is n words*/
-  if (HAL_CRYP_Decrypt(&hcryp, (uint32_t *)&DataEncrypted[0U], (uint16_t) (Length / 4U), (uint32_t *)pData, SaesTimeout) != HAL_OK)
+  if (Crypto_Acquire(&owned) != HAL_OK)
   {
-    return 4;
+    memset(pData, 0x00, Length);
+    return PROV_ERR_CRYPTO;
   }
-  if (HAL_CRYP_DeInit(&hcryp) != HAL_OK)
+
+  /* Decrypted in place behind the IV and tag */
+  if (SAESSession_DecryptGCM(&ObkSession, iv, aad, 2U, &p_record[OBK_GCM_OVERHEAD / 4U],
+                             Length - OBK_GCM_OVERHEAD, &p_record[OBK_GCM_OVERHEAD / 4U], tag) != HAL_OK)
   {
-    return 5;
+    ret = PROV_ERR_CRYPTO;
   }
+  else if (MemoryCompare((uint8_t *)tag, (uint8_t *)&p_record[4], sizeof(tag)) != 0U)
+  {
+    ret = PROV_ERR_VERIFY;
+  }
+
+  Crypto_Release(owned);
+
+  if (ret == PROV_OK)
+  {
+    memmove(pData, &p_record[OBK_GCM_OVERHEAD / 4U], Length - OBK_GCM_OVERHEAD);
+    memset((uint8_t *)pData + Length - OBK_GCM_OVERHEAD, 0x00, OBK_GCM_OVERHEAD);
+  }
+  else
+  {
+    /* Unauthenticated data never reaches the caller */
+    memset(pData, 0x00, Length);
+  }
+  memset(tag, 0x00, sizeof(tag));
+
+  return ret;
+}
+
+/**
+  * @brief  Read OBkeys, decrypting them when they were written encrypted
+  * @note   A GCM record is returned without its IV and tag : the payload
+  *         fills the first Length - OBK_GCM_OVERHEAD bytes of pData.
+  * @param  Offset Offset in the OBKeys area (aligned on 16 bytes)
+  * @param  pData Data buffer to be filled (aligned on 4 bytes)
+  * @param  Length Number of bytes stored (multiple of 16 bytes)
+  * @param  Encrypted Header encrypted value of the record (OBK_RECORD_xxx)
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t OBKProvisioning_Read(uint32_t Offset, void *pData, uint32_t Length, uint32_t Encrypted)
+{
+  if (Encrypted == OBK_RECORD_GCM)
+  {
+    return OBK_Flash_ReadGCM(Offset, pData, Length);
+  }
+  return (Encrypted != OBK_RECORD_PLAIN) ? OBK_Flash_ReadEncrypted(Offset, pData, Length) :
+         OBK_Read(Offset, pData, Length);
+}
+
+/**
+  * @brief  Check that a batch of records landed correctly in OBK
+  * @note   Each record is read back from the swapped OBKeys, decrypted and
+  *         compared in constant time with its source. The SHA256 leading an
+  *         encrypted .obk payload is also recomputed over the decrypted data,
+  *         a GCM record is checked by its tag during the decryption instead.
+  * @param  pRecords Records just written by OBKProvisioning_WriteRecords()
+  * @param  NbRecords Number of records
+  * @retval PROV_OK if every record matches, PROV_ERR_VERIFY if one cannot be
+  *         read back or differs, PROV_ERR_PARAM or PROV_ERR_CRYPTO otherwise
+  */
+int32_t OBKProvisioning_VerifyRecords(const OBK_Record_t *pRecords, uint32_t NbRecords)
+{
+  uint8_t *p_readback = (uint8_t *)OBK_Staging;
+  uint8_t sha256[SHA256_LENGTH] = { 0U };
+  uint32_t diff = 0U;
+  uint32_t owned = 0U;
+  int32_t ret = PROV_OK;
+
+  if ((pRecords == NULL) || (NbRecords == 0U) || (is_batch_valid(pRecords, NbRecords) != 1))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  /* OBKeys are read through the C-bus, drop lines cached before the swap */
+  (void) HAL_ICACHE_Invalidate();
+
+  /* One DHUK session for all the records */
+  if (Crypto_Acquire(&owned) != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
+
+  for (uint32_t r = 0U; (r < NbRecords) && (ret == PROV_OK); r++)
+  {
+    uint32_t offset = pRecords[r].Header.addr - FLASH_OBK_BASE_S;
+    uint32_t length = pRecords[r].Header.length;
+    uint32_t payload = length;
+
+    if (pRecords[r].Header.encrypted == OBK_RECORD_GCM)
+    {
+      payload = length - OBK_GCM_OVERHEAD;
+      if (OBK_Flash_ReadGCM(offset, p_readback, length) != PROV_OK)
+      {
+        ret = PROV_ERR_VERIFY;
+      }
+    }
+    else if (pRecords[r].Header.encrypted != OBK_RECORD_PLAIN)
+    {
+      if (pRecords[r].Header.encrypted == OBK_RECORD_CBC_SEALED)
+      {
+        /* The source is the stored ciphertext, the decrypted payload is
+           only checked against its leading SHA256 */
+        payload = 0U;
+        if (OBK_Read(offset, p_readback, length) != PROV_OK)
+        {
+          ret = PROV_ERR_VERIFY;
+        }
+        diff |= MemoryCompare(p_readback, (uint8_t *)pRecords[r].pData, length);
+      }
+
+      if ((ret != PROV_OK) || (OBK_Flash_ReadEncrypted(offset, p_readback, length) != PROV_OK))
+      {
+        ret = PROV_ERR_VERIFY;
+      }
+      else if ((length > SHA256_LENGTH) &&
+               (Compute_SHA256(&p_readback[SHA256_LENGTH], length - SHA256_LENGTH, sha256) != HAL_OK))
+      {
+        ret = PROV_ERR_CRYPTO;
+      }
+      else
+      {
+        diff |= MemoryCompare(p_readback, sha256, SHA256_LENGTH);
+      }
+    }
+    else if (OBK_Read(offset, p_readback, length) != PROV_OK)
+    {
+      ret = PROV_ERR_VERIFY;
+    }
+
+    /* Accumulate mismatches, no early exit on a differing byte */
+    diff |= MemoryCompare(p_readback, (uint8_t *)pRecords[r].pData, payload);
+  }
+
+  Crypto_Release(owned);
+  memset(OBK_Staging, 0x00, sizeof(OBK_Staging));
+  memset(sha256, 0x00, sizeof(sha256));
+
+  if ((ret == PROV_OK) && (diff != 0U))
+  {
+    ret = PROV_ERR_VERIFY;
+  }
+  return ret;
+}
+
+/**
+  * @brief  Check an .obk header against the provisioning rules
+  * @note   The target slot must be blank and outside the OBK directory, the
+  *         record must be flagged as encrypted, fit in the HDPL1 OBKeys area
+  *         and the DA record must have its fixed size. Other records may span
+  *         the rest of the area.
+  * @param  pHeader .obk file header
+  * @retval PROV_OK if the header can be provisioned, PROV_ERR_STATE if the
+  *         slot is already provisioned, PROV_ERR_PARAM otherwise
+  */
+int32_t OBKProvisioning_CheckHeader(const OBK_Header_t *pHeader)
+{
+	uint32_t offset = pHeader->addr - FLASH_OBK_BASE_S;
+
+	if ((pHeader->addr < FLASH_OBK_BASE_DA) || (is_range_valid(offset) != 1) ||
+	    ((offset < (OBK_DIR_OFFSET + OBK_DIR_SIZE)) && ((offset + pHeader->length) > OBK_DIR_OFFSET)))
+	{
+		PRINTF("Wrong address (0x%lx)\r\n", pHeader->addr);
+		return PROV_ERR_PARAM;
+	}
+
+	if ((*(uint32_t *)(pHeader->addr)) != 0xFFFFFFFF)
+	{
+		PRINTF("Already provisioned (0x%lx) !\r\n", pHeader->addr);
+		return PROV_ERR_STATE;
+	}
+
+	if (pHeader->encrypted != OBK_RECORD_CBC)
+	{
+		PRINTF("Wrong Header encrypted value (0x%lx)\r\n", pHeader->encrypted);
+		return PROV_ERR_PARAM;
+	}
+
+	if ((pHeader->length <= SHA256_LENGTH) ||
+	    (is_write_aligned(offset) != 1) || (is_write_allowed(pHeader->length) != 1) ||
+	    (is_range_valid(offset + pHeader->length - 1U) != 1) ||
+	    ((pHeader->addr == FLASH_OBK_BASE_DA) && (pHeader->length != MAX_SIZE_CFG_DA)))
+	{
+		printf("Wrong size (0x%lx)\r\n", pHeader->length);
+		return PROV_ERR_PARAM;
+	}
 
-  return 0;
+	return PROV_OK;
 }
 
+#ifndef DA_CONFIG_TRANSPORT_KEY_ID
+/**
+  * @brief  Check the integrity hash leading the embedded DA config payload
+  * @param  provData DA config payload
+  * @param  Length Payload length
+  * @retval PROV_OK if the hash matches, PROV_ERR_VERIFY otherwise
+  */
+static int32_t Check_DAConfigHash(const uint8_t *provData, uint32_t Length)
+{
+	uint8_t sha256[SHA256_LENGTH] = { 0U };
+
+	PRINTF("Check embedded DA Config Hash \r\n");
+	HAL_StatusTypeDef status = Compute_SHA256((uint8_t *) (provData + SHA256_LENGTH), Length - SHA256_LENGTH, sha256);
 
+	if (status != HAL_OK)
+	{
+		PRINTF("HASH fail!\r\n");
+	}
 
-void OBKProvisioning_ProvisionDA(void)
+	if (MemoryCompare((uint8_t *)provData, &sha256[0], SHA256_LENGTH) != 0U)
+	{
+		printf("Wrong hash \r\n");
+		return PROV_ERR_VERIFY;
+	}
+	return PROV_OK;
+}
+#endif
+
+/**
+  * @brief  Check the embedded DA config and build the DA record to program
+  * @note   A transport encrypted config (DA_CONFIG_TRANSPORT_KEY_ID set by
+  *         Tools/obk_transport.py) is checked against its SHA256, then
+  *         re-encrypted on device from the transport key to the DHUK without
+  *         its plain payload being stored. The transport key is provisioned
+  *         first from Keys_Config.h when it is not in OBK yet. A plain config
+  *         is checked against the integrity hash leading its payload.
+  * @param  pRecord Set to the header and payload to program
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+static int32_t DA_PrepareRecord(OBK_Record_t *pRecord)
+{
+	OBK_Header_t *pHeader = (OBK_Header_t *)DA_Config;
+	uint8_t *provData = (uint8_t *)DA_Config + sizeof(OBK_Header_t);
+
+	pRecord->Header = *pHeader;
+	pRecord->pData = provData;
+
+#ifdef DA_CONFIG_TRANSPORT_KEY_ID
+	PRINTF("Check embedded DA Config transport hash \r\n");
+	int32_t result = OBKTransport_Check(DA_Config, sizeof(DA_Config));
+	if (result != PROV_OK)
+	{
+		printf("Wrong hash \r\n");
+		return result;
+	}
+
+	if (OBKDirectory_Find(DA_CONFIG_TRANSPORT_KEY_ID) == NULL)
+	{
+		PRINTF("Provisioning transport key 0x%x from Keys_Config.h\r\n", DA_CONFIG_TRANSPORT_KEY_ID);
+		result = OemKey_ProvisionConfig(DA_CONFIG_TRANSPORT_KEY_ID);
+		if (result != PROV_OK)
+		{
+			printf("Transport key not provisioned : %s\r\n", Prov_StatusName((Prov_Status_t)result));
+			return result;
+		}
+	}
+
+	result = OBKTransport_Reencrypt(DA_CONFIG_TRANSPORT_KEY_ID, provData, provData + OBK_TRANSPORT_IV_SIZE,
+	                                pHeader->length, DA_Sealed);
+	if (result != PROV_OK)
+	{
+		PRINTF("DA config not re-encrypted with key 0x%x : %s\r\n", DA_CONFIG_TRANSPORT_KEY_ID,
+		       Prov_StatusName((Prov_Status_t)result));
+		return result;
+	}
+	pRecord->Header.encrypted = OBK_RECORD_CBC_SEALED;
+	pRecord->pData = (const uint8_t *)DA_Sealed;
+#else
+	if (Check_DAConfigHash(provData, pHeader->length) != PROV_OK)
+	{
+		return PROV_ERR_VERIFY;
+	}
+#endif
+	return PROV_OK;
+}
+
+int32_t OBKProvisioning_ProvisionDA(void)
 {
 	OBK_Header_t *pHeader;
 	uint8_t *provData;
-	uint8_t sha256[SHA256_LENGTH] = { 0U };
+	int32_t result;
 
 	PRINTF("Check provisioning status ...\r\n");
-	if ((*(uint32_t *)(FLASH_OBK_BASE_DA)) != 0xFFFFFFFF)
+	if (OBKDirectory_Find(OBK_DIR_ID_DA) != NULL)
 	{
-		PRINTF("DA Already provisioned !\r\n");
-		return;
+		PRINTF("DA Already provisioned ! A newer DA config can be rotated in\r\n");
+		return PROV_OK;
 	}
 
 	PRINTF("Provisioning DA using embedded DA config\r\n");
@@ -328,49 +1062,145 @@ void OBKProvisioning_ProvisionDA(void)
 	provData = (uint8_t *)DA_Config + sizeof(OBK_Header_t);
 
 	// Check consistency of DA_ConfigData buffer
-	if(pHeader->encrypted != 1)
+	if (pHeader->addr != FLASH_OBK_BASE_DA)
 	{
-		PRINTF("Wrong Header encrypted value (0x%lx)\r\n", pHeader->encrypted);
-		return;
+		PRINTF("Wrong address (0x%lx)\r\n", pHeader->addr);
+		return PROV_ERR_PARAM;
 	}
 
-	if((pHeader->addr) != 0x0FFD0100UL)
+	result = OBKProvisioning_CheckHeader(pHeader);
+	if (result != PROV_OK)
 	{
-		PRINTF("Wrong address (0x%lx)\r\n", pHeader->addr);
+		return result;
+	}
+
+	OBK_Record_t record;
+	result = DA_PrepareRecord(&record);
+	if (result != PROV_OK)
+	{
+		return result;
+	}
+
+	PRINTF("Provisioning %2.2x %2.2x ...\r\n", provData[0], provData[1]);
+
+	result = OBKDirectory_Register(OBK_DIR_ID_DA, pHeader);
+	if (result != PROV_OK)
+	{
+		PRINTF("DA record not registered : %s\r\n", Prov_StatusName((Prov_Status_t)result));
+		return result;
+	}
+
+	/* DA record and directory entry written together */
+	(void) OBKDirectory_SetVersion(OBK_DIR_ID_DA, DA_CONFIG_VERSION);
+	result = OBKDirectory_Commit(&record, 1U);
+	if (result != PROV_OK)
+	{
+		PRINTF("Error Writing OBK file : %s\r\n", Prov_StatusName((Prov_Status_t)result));
+		return result;
+	}
+
+	result = OBKProvisioning_VerifyRecords(&record, 1U);
+	if (result != PROV_OK)
+	{
+		PRINTF("Provisioning verify failed : %s\r\n", Prov_StatusName((Prov_Status_t)result));
+		return result;
+	}
+
+	PRINTF("Provisioning done and verified\r\n");
+	NVIC_SystemReset();
+	return PROV_OK;
+}
+
+/**
+  * @brief  Replace the provisioned DA record by a newer embedded DA config
+  * @note   The embedded config must pass the integrity hash check and carry a
+  *         higher DA_CONFIG_VERSION than the provisioned one. The new record,
+  *         a backup of the current one (copied still encrypted) and the
+  *         directory are committed by a single swap. If the new record does
+  *         not verify, the backup is written back to the DA slot.
+  * @retval None
+  */
+void OBKProvisioning_RotateDA(void)
+{
+	OBK_Header_t *pHeader = (OBK_Header_t *)DA_Config;
+	const OBK_DirEntry_t *pEntry;
+	OBK_Record_t records[2];
+	OBK_Header_t backup = { 0U };
+	uint32_t old_version;
+	int32_t result;
+
+	PRINTF("Check provisioned DA version ...\r\n");
+	pEntry = OBKDirectory_Find(OBK_DIR_ID_DA);
+	if (pEntry == NULL)
+	{
+		PRINTF("DA not provisioned yet\r\n");
 		return;
 	}
+	old_version = pEntry->Version;
 
-	if((pHeader->length) != 0x60)
+	if (DA_CONFIG_VERSION <= old_version)
 	{
-		printf("Wrong size (0x%lx)\r\n", pHeader->length);
+		PRINTF("Embedded DA config version %lu is not newer than %lu\r\n", (uint32_t)DA_CONFIG_VERSION, old_version);
 		return;
 	}
 
-	PRINTF("Check embedded DA Config Hash \r\n");
-	HAL_StatusTypeDef status = Compute_SHA256((uint8_t *) (provData + SHA256_LENGTH), pHeader->length - SHA256_LENGTH, sha256);
+	if ((pHeader->addr != FLASH_OBK_BASE_DA) || (pHeader->encrypted != 1U) || (pHeader->length != MAX_SIZE_CFG_DA))
+	{
+		PRINTF("Wrong embedded DA config header\r\n");
+		return;
+	}
 
-	if (status != HAL_OK)
+	if (DA_PrepareRecord(&records[0]) != PROV_OK)
 	{
-		PRINTF("HASH fail!\r\n");
+		return;
 	}
 
-	if (MemoryCompare((uint8_t *)provData, &sha256[0], SHA256_LENGTH) != 0U)
+	/* The previous version stays readable from the backup slot */
+	if ((OBKProvisioning_Read(OBK_HDPL1_OFFSET, DA_Backup, MAX_SIZE_CFG_DA, 0U) != PROV_OK) ||
+	    (OBKDirectory_Allocate(OBK_DIR_ID_DA_BACKUP, MAX_SIZE_CFG_DA, &backup) != PROV_OK) ||
+	    (OBKDirectory_SetVersion(OBK_DIR_ID_DA_BACKUP, old_version) != PROV_OK) ||
+	    (OBKDirectory_Register(OBK_DIR_ID_DA, pHeader) != PROV_OK) ||
+	    (OBKDirectory_SetVersion(OBK_DIR_ID_DA, DA_CONFIG_VERSION) != PROV_OK))
 	{
-		printf("Wrong hash \r\n");
+		PRINTF("Cannot prepare DA rotation\r\n");
+		(void) OBKDirectory_Load();
+		memset(DA_Backup, 0x00, sizeof(DA_Backup));
 		return;
 	}
+	backup.encrypted = 0U;
 
-	PRINTF("Provisioning %2.2x %2.2x ...\r\n", provData[0], provData[1]);
+	records[1].Header = backup;
+	records[1].pData = (const uint8_t *)DA_Backup;
 
-	uint32_t offset = pHeader->addr - FLASH_OBK_BASE_S;
-	uint32_t result = OBK_Flash_WriteEncrypted(offset, (const void*)(provData), pHeader->length);
-	if (result !=0)
+	PRINTF("Rotating DA from version %lu to %lu ...\r\n", old_version, (uint32_t)DA_CONFIG_VERSION);
+	result = OBKDirectory_Commit(records, 2U);
+	if (result != PROV_OK)
 	{
-		PRINTF("Error Writing OBK file : %ld\r\n", result);
+		/* Nothing swapped, the previous version is still in place */
+		PRINTF("Error Writing OBK file : %s\r\n", Prov_StatusName((Prov_Status_t)result));
+		memset(DA_Backup, 0x00, sizeof(DA_Backup));
+		return;
+	}
+
+	result = OBKProvisioning_VerifyRecords(&records[0], 1U);
+	if (result != PROV_OK)
+	{
+		PRINTF("Rotation verify failed : %s, restoring version %lu\r\n", Prov_StatusName((Prov_Status_t)result), old_version);
+		records[0].Header.encrypted = 0U;
+		records[0].pData = (const uint8_t *)DA_Backup;
+		if ((OBKDirectory_Register(OBK_DIR_ID_DA, pHeader) != PROV_OK) ||
+		    (OBKDirectory_SetVersion(OBK_DIR_ID_DA, old_version) != PROV_OK) ||
+		    (OBKDirectory_Commit(&records[0], 1U) != PROV_OK) ||
+		    (OBKProvisioning_VerifyRecords(&records[0], 1U) != PROV_OK))
+		{
+			PRINTF("Restore failed, previous version kept in backup slot 0x%lx\r\n", backup.addr);
+		}
+		memset(DA_Backup, 0x00, sizeof(DA_Backup));
 		return;
 	}
 
-	PRINTF("Provisioning done\r\n");
+	memset(DA_Backup, 0x00, sizeof(DA_Backup));
+	PRINTF("DA rotated and verified\r\n");
 	NVIC_SystemReset();
 }
 
@@ -379,13 +1209,13 @@ void OBKProvisioning_ReadDA(void)
 	OBK_Header_t *pHeader;
 	pHeader = (OBK_Header_t *)DA_Config;
 	uint32_t offset = pHeader->addr - FLASH_OBK_BASE_S;
-	uint8_t DABuffer[MAX_SIZE_CFG_DA];
-	uint32_t result;
+	uint8_t DABuffer[MAX_SIZE_CFG_DA] __ALIGNED(4); /* Decrypted in place by DMA */
+	int32_t result;
 
 	printf("Read provisioned DA\r\n");
 	result = OBK_Read(offset, (void *)DABuffer, pHeader->length);
 
-	if (result != 0)
+	if (result != PROV_OK)
 	{
 		printf("Error OBK_Read\r\n");
 	}
@@ -400,9 +1230,11 @@ void OBKProvisioning_ReadDA(void)
 	}
 
 	printf("\r\nDecrypt provisioned DA\r\n");
+	(void) OBKProvisioning_OpenCryptoSession();
 	result = OBK_Flash_ReadEncrypted(offset, (void *)DABuffer, pHeader->length);
+	OBKProvisioning_CloseCryptoSession();
 
-	if (result != 0)
+	if (result != PROV_OK)
 	{
 		printf("Error OBK_Flash_ReadEncrypted\r\n");
 	}
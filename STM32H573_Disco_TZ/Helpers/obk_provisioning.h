@@ -1,8 +1,68 @@
 #ifndef OBK_PROVISIONING_H
 #define OBK_PROVISIONING_H
 #include "main.h"
+#include "prov_result.h"
 
-void OBKProvisioning_ProvisionDA(void);
+#define OBK_SHA256_LENGTH         (32U)
+#define OBK_MAX_RECORD_SIZE       (0x60U)   /* DA record size */
+#define OBK_HDPL1_SIZE            (0x800U)
+#define OBK_HDPL1_OFFSET          (0x100U)
+#define OBK_HDPL1_END             (0x8FFU)
+
+#define FLASH_OBK_BASE_DA         (FLASH_OBK_BASE_S + OBK_HDPL1_OFFSET)
+
+/* OBK directory, plain record right after the DA record */
+#define OBK_DIR_OFFSET            (OBK_HDPL1_OFFSET + OBK_MAX_RECORD_SIZE)
+#define OBK_DIR_SIZE              (0x90U)
+
+/* Header encrypted values */
+#define OBK_RECORD_PLAIN          (0U)
+#define OBK_RECORD_CBC            (1U)      /* DHUK AES-CBC, fixed IV (.obk files, DA record) */
+#define OBK_RECORD_GCM            (2U)      /* DHUK AES-GCM, random IV and tag stored with the record */
+#define OBK_RECORD_CBC_SEALED     (3U)      /* CBC payload already encrypted on device, programmed as is */
+
+/* GCM record : IV (3 words), marker, tag (4 words), then the encrypted
+   payload. Header length is the stored size, the payload is 32 bytes less. */
+#define OBK_GCM_OVERHEAD          (0x20U)
+#define OBK_GCM_MARKER            (0x324D4347U)   /* "GCM2" */
+#define OBK_GCM_RECORD_SIZE(n)    ((n) + OBK_GCM_OVERHEAD)
+
+typedef struct {
+    uint32_t addr;
+    uint32_t length;
+    uint32_t encrypted;
+  } OBK_Header_t;
+
+/* One OBK record : .obk header plus a pointer to its payload
+   (Header length - OBK_GCM_OVERHEAD bytes for a GCM record) */
+typedef struct {
+    OBK_Header_t Header;
+    const uint8_t *pData;
+  } OBK_Record_t;
+
+/* Durations of the last OBK write cycle, in microseconds */
+typedef struct {
+    uint32_t TotalUs;     /* Encrypt, erase, program and swap */
+    uint32_t SwapUs;
+    uint32_t StallUs;     /* Longest time the CPU waited on the busy flash */
+    uint32_t SwapOffset;  /* Key slots carried over by the swap */
+  } OBK_WriteTiming_t;
+
+/* IV of the CBC records */
+extern const uint32_t a_aes_iv[4];
+
+int32_t OBKProvisioning_ProvisionDA(void);
+void OBKProvisioning_RotateDA(void);
 void OBKProvisioning_ReadDA(void);
+int32_t OBKProvisioning_CheckHeader(const OBK_Header_t *pHeader);
+int32_t OBKProvisioning_OpenCryptoSession(void);
+int32_t OBKProvisioning_SuspendCryptoSession(void);
+void OBKProvisioning_CloseCryptoSession(void);
+int32_t OBKProvisioning_WriteRecords(const OBK_Record_t *pRecords, uint32_t NbRecords);
+int32_t OBKProvisioning_WriteRecordsBounded(const OBK_Record_t *pRecords, uint32_t NbRecords, uint32_t LiveEnd);
+void OBKProvisioning_GetLastTiming(OBK_WriteTiming_t *pTiming);
+int32_t OBKProvisioning_Read(uint32_t Offset, void *pData, uint32_t Length, uint32_t Encrypted);
+int32_t OBKProvisioning_VerifyRecords(const OBK_Record_t *pRecords, uint32_t NbRecords);
+uint32_t OBKProvisioning_DoubleECC_Taken(void);
 
 #endif
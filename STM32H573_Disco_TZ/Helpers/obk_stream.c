@@ -0,0 +1,193 @@
+#include "obk_stream.h"
+#include "obk_provisioning.h"
+#include "hash_engine.h"
+#include "obk_directory.h"
+#include "usart.h"
+#include "string.h" //For memset
+
+#define OBK_STREAM_CHUNK          (0x10U)
+#define OBK_STREAM_START_TIMEOUT  (30000U)
+#define OBK_STREAM_TIMEOUT        (1000U)
+
+/* Secure SRAM staging area receiving the streamed payloads */
+static uint32_t StreamBuffer[OBK_HDPL1_SIZE / 4U];
+static OBK_Record_t StreamRecords[OBK_STREAM_MAX_FILES];
+
+/**
+  * @brief  Send the ACK/NACK byte of a protocol step
+  * @param  Code OBK_STREAM_ACK or OBK_STREAM_NACK
+  * @retval None
+  */
+static void Stream_Reply(uint8_t Code)
+{
+  (void) HAL_UART_Transmit(&huart1, &Code, 1U, OBK_STREAM_TIMEOUT);
+}
+
+/**
+  * @brief  Receive bytes from the host
+  * @param  pData Destination buffer
+  * @param  Length Number of bytes
+  * @param  Timeout Timeout in ms
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef Stream_Read(void *pData, uint32_t Length, uint32_t Timeout)
+{
+  return Console_Receive(pData, Length, Timeout);
+}
+
+/**
+  * @brief  Receive a payload and check its integrity hash on the fly
+  * @note   The first 32 bytes are the expected SHA256 of the remaining bytes.
+  *         Each chunk is fed to the HASH peripheral as soon as it is received
+  *         so the digest is ready when the last byte arrives.
+  * @param  pHeader Header of the payload, already checked
+  * @param  pPayload Staging buffer (aligned on 4 bytes)
+  * @retval PROV_OK, PROV_ERR_PARAM if the payload is not received,
+  *         PROV_ERR_CRYPTO on HASH error, PROV_ERR_VERIFY if the hash differs
+  */
+static int32_t Stream_ReceivePayload(const OBK_Header_t *pHeader, uint8_t *pPayload)
+{
+  uint8_t sha256[OBK_SHA256_LENGTH] = { 0U };
+  HashEngine_Ctx_t ctx;
+  uint8_t diff = 0U;
+  uint32_t i;
+
+  if (Stream_Read(pPayload, OBK_SHA256_LENGTH, OBK_STREAM_TIMEOUT) != HAL_OK)
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  if (HashEngine_Init(&ctx) != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
+
+  for (i = OBK_SHA256_LENGTH; i < pHeader->length; i += OBK_STREAM_CHUNK)
+  {
+    if (Stream_Read(&pPayload[i], OBK_STREAM_CHUNK, OBK_STREAM_TIMEOUT) != HAL_OK)
+    {
+      return PROV_ERR_PARAM;
+    }
+
+    if (HashEngine_Update(&ctx, &pPayload[i], OBK_STREAM_CHUNK) != HAL_OK)
+    {
+      return PROV_ERR_CRYPTO;
+    }
+  }
+
+  if (HashEngine_Final(&ctx, sha256) != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
+
+  /* Constant time comparison */
+  for (i = 0U; i < OBK_SHA256_LENGTH; i++)
+  {
+    diff |= pPayload[i] ^ sha256[i];
+  }
+
+  return (diff == 0U) ? PROV_OK : PROV_ERR_VERIFY;
+}
+
+/**
+  * @brief  Receive one or more .obk files on USART1 and provision them in OBK
+  * @note   Headers are checked with the same rules as the embedded DA config,
+  *         payloads are hashed while they are received, then all records are
+  *         written with a single OBK erase/program/swap cycle and read back
+  *         for verification before the final answer.
+  * @retval PROV_OK, PROV_ERR_PARAM for a session or header not received or
+  *         invalid, error status of the failing step otherwise
+  */
+int32_t OBKStream_Receive(void)
+{
+  uint32_t session[2] = { 0U };
+  uint32_t nb_files;
+  uint32_t used = 0U;
+  uint32_t f;
+  uint32_t tick;
+  int32_t ret = PROV_OK;
+
+  PRINTF("Waiting for .obk files on USART1 ...\r\n");
+
+  /* Drop any overrun left by the menu polling */
+  __HAL_UART_CLEAR_FLAG(&huart1, UART_CLEAR_OREF);
+
+  if ((Stream_Read(session, sizeof(session), OBK_STREAM_START_TIMEOUT) != HAL_OK) ||
+      (session[0] != OBK_STREAM_MAGIC) || (session[1] == 0U) || (session[1] > OBK_STREAM_MAX_FILES))
+  {
+    Stream_Reply(OBK_STREAM_NACK);
+    return PROV_ERR_PARAM;
+  }
+  nb_files = session[1];
+  tick = HAL_GetTick();
+  Stream_Reply(OBK_STREAM_ACK);
+
+  for (f = 0U; f < nb_files; f++)
+  {
+    OBK_Header_t *pHeader = &StreamRecords[f].Header;
+    uint8_t *pPayload = (uint8_t *)StreamBuffer + used;
+
+    if (Stream_Read(pHeader, sizeof(OBK_Header_t), OBK_STREAM_TIMEOUT) != HAL_OK)
+    {
+      ret = PROV_ERR_PARAM;
+      break;
+    }
+
+    ret = OBKProvisioning_CheckHeader(pHeader);
+    if ((ret == PROV_OK) && ((used + pHeader->length) > sizeof(StreamBuffer)))
+    {
+      ret = PROV_ERR_PARAM;
+    }
+    if (ret != PROV_OK)
+    {
+      break;
+    }
+    Stream_Reply(OBK_STREAM_ACK);
+
+    ret = Stream_ReceivePayload(pHeader, pPayload);
+    if (ret != PROV_OK)
+    {
+      break;
+    }
+    Stream_Reply(OBK_STREAM_ACK);
+
+    StreamRecords[f].pData = pPayload;
+    used += pHeader->length;
+  }
+
+  /* The flash wait keeps the host informed, see FlashJob_IdleCallback() */
+  Console_SetKeepAlive(OBK_STREAM_BUSY);
+
+  /* Every file gets a directory entry, written in the same OBK cycle */
+  for (uint32_t i = 0U; (ret == PROV_OK) && (i < nb_files); i++)
+  {
+    ret = OBKDirectory_Register(OBKDirectory_IdFromAddr(StreamRecords[i].Header.addr), &StreamRecords[i].Header);
+  }
+
+  if (ret == PROV_OK)
+  {
+    ret = OBKDirectory_Commit(StreamRecords, nb_files);
+  }
+  else
+  {
+    /* Drop the entries registered for this session */
+    (void) OBKDirectory_Load();
+  }
+
+  /* Read back while the source payloads are still in StreamBuffer */
+  if (ret == PROV_OK)
+  {
+    ret = OBKProvisioning_VerifyRecords(StreamRecords, nb_files);
+  }
+
+  Console_SetKeepAlive(0U);
+
+  memset(StreamBuffer, 0x00, sizeof(StreamBuffer));
+  memset(StreamRecords, 0x00, sizeof(StreamRecords));
+
+  Stream_Reply((ret == PROV_OK) ? OBK_STREAM_ACK : OBK_STREAM_NACK);
+  PRINTF("OBK stream %s : %ld file(s) in %ld ms\r\n", (ret == PROV_OK) ? "done" : Prov_StatusName((Prov_Status_t)ret), f,
+         HAL_GetTick() - tick);
+
+  return ret;
+}
@@ -0,0 +1,24 @@
+#ifndef OBK_STREAM_H
+#define OBK_STREAM_H
+#include "main.h"
+
+/* Session protocol (little endian) :
+ *   host   : "OBKS" + number of files (4 bytes)        device : ACK / NACK
+ *   host   : .obk header (12 bytes)                    device : ACK / NACK
+ *   host   : .obk payload (header length bytes)        device : ACK / NACK
+ *   ... repeated for each file ...
+ *   device : ACK once all records are written in OBK, NACK otherwise
+ * ACK/NACK are ASCII control characters so that console traces sent in
+ * between can be skipped by the host. While the records are written the
+ * device sends BUSY every CONSOLE_KEEPALIVE_MS, the host restarts its
+ * answer timeout on it.
+ */
+#define OBK_STREAM_MAGIC          (0x534B424FU) /* "OBKS" */
+#define OBK_STREAM_ACK            (0x06U)
+#define OBK_STREAM_NACK           (0x15U)
+#define OBK_STREAM_BUSY           (0x16U)
+#define OBK_STREAM_MAX_FILES      (16U)
+
+int32_t OBKStream_Receive(void);
+
+#endif
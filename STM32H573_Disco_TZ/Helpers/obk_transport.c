@@ -0,0 +1,180 @@
+#include "obk_transport.h"
+#include "saes_session.h"
+#include "hash_engine.h"
+#include "oem_key.h"
+#include "string.h"
+
+#define OBK_TRANSPORT_TIMEOUT     (100U)
+
+/**
+  * @brief  Wait for the end of one block in AES or SAES
+  * @param  Instance AES or SAES_S
+  * @retval PROV_OK, PROV_ERR_CRYPTO on read/write or key error or timeout
+  */
+static int32_t Transport_WaitBlock(AES_TypeDef *Instance)
+{
+  uint32_t tickstart = HAL_GetTick();
+
+  while (READ_BIT(Instance->ISR, AES_ISR_CCF) == 0U)
+  {
+    if ((READ_BIT(Instance->ISR, AES_ISR_RWEIF | AES_ISR_KEIF) != 0U) ||
+        ((HAL_GetTick() - tickstart) > OBK_TRANSPORT_TIMEOUT))
+    {
+      return PROV_ERR_CRYPTO;
+    }
+  }
+  return PROV_OK;
+}
+
+/**
+  * @brief  Check the size and SHA256 of a transport encrypted .obk file
+  * @param  pFile Transport file, as written by Tools/obk_transport.py
+  * @param  Size File size in bytes
+  * @retval PROV_OK, PROV_ERR_PARAM for a size not matching the header,
+  *         PROV_ERR_CRYPTO if the hash cannot be computed, PROV_ERR_VERIFY if
+  *         it does not match
+  */
+int32_t OBKTransport_Check(const uint8_t *pFile, uint32_t Size)
+{
+  uint8_t sha256[OBK_SHA256_LENGTH];
+  OBK_Header_t header;
+  uint8_t diff = 0U;
+
+  if ((pFile == NULL) || (Size < OBK_TRANSPORT_SIZE(0U)))
+  {
+    return PROV_ERR_PARAM;
+  }
+  memcpy(&header, pFile, sizeof(header));
+  if ((header.length == 0U) || ((header.length % 16U) != 0U) || (Size != OBK_TRANSPORT_SIZE(header.length)))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  if (HashEngine_SHA256(pFile, Size - OBK_SHA256_LENGTH, sha256) != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
+  for (uint32_t i = 0U; i < OBK_SHA256_LENGTH; i++)
+  {
+    diff |= sha256[i] ^ pFile[Size - OBK_SHA256_LENGTH + i];
+  }
+  return (diff == 0U) ? (PROV_OK) : (PROV_ERR_VERIFY);
+}
+
+/**
+  * @brief  Re-encrypt a transport encrypted payload with the DHUK
+  * @note   AES decrypts with the transport key, shared by SAES so that it is
+  *         never readable, and each decrypted word is moved by the CPU from
+  *         the AES output register straight into the SAES input register.
+  *         SAES encrypts it under the DHUK in CBC from a_aes_iv, the format of
+  *         .obk payloads, so the plain payload is never stored in SRAM.
+  *         A DMA chain between both peripherals is not possible : they have
+  *         no input FIFO and a write while busy is a write error. The OBK
+  *         DHUK session is suspended, it restores itself on its next access.
+  * @param  KeyId OEM key ID of the transport key (OEM_KEY_USE_AES)
+  * @param  pIV Transport IV, 16 bytes, the counter in its last 4 bytes
+  * @param  pInput Transport encrypted payload
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Payload encrypted with the DHUK, cleared on error
+  * @retval PROV_OK, PROV_ERR_PARAM for wrong parameters, PROV_ERR_STATE if
+  *         the transport key is not an AES key, PROV_ERR_CRYPTO on SAES or AES
+  *         error, error status of OemKey_Load() otherwise
+  */
+int32_t OBKTransport_Reencrypt(uint16_t KeyId, const uint8_t *pIV, const uint8_t *pInput, uint32_t Length,
+                               uint32_t *pOutput)
+{
+  CRYP_HandleTypeDef hcryp = {0};
+  SAES_Session_t seal = {0};
+  uint32_t block[4];
+  uint32_t iv[4];
+  uint32_t tickstart;
+  int32_t ret;
+
+  if ((pIV == NULL) || (pInput == NULL) || (pOutput == NULL) || (Length == 0U) || ((Length % 16U) != 0U))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  ret = OemKey_Load(KeyId, &hcryp, CRYP_AES_CTR, NULL);
+  if ((ret != PROV_OK) || (hcryp.Instance != AES))
+  {
+    OemKey_Unload(&hcryp);
+    return (ret != PROV_OK) ? ret : PROV_ERR_STATE;
+  }
+
+  if (SAESSession_Open(&seal, a_aes_iv) != HAL_OK)
+  {
+    ret = PROV_ERR_CRYPTO;
+  }
+
+  /* The DHUK is loaded in the background after the SAES initialization */
+  tickstart = HAL_GetTick();
+  while ((ret == PROV_OK) && (READ_BIT(SAES_S->SR, AES_SR_KEYVALID) == 0U))
+  {
+    if ((HAL_GetTick() - tickstart) > OBK_TRANSPORT_TIMEOUT)
+    {
+      ret = PROV_ERR_CRYPTO;
+    }
+  }
+
+  if (ret == PROV_OK)
+  {
+    /* CTR over byte swapped words : the transport file is a byte stream and
+       the IV registers take the big-endian counter block */
+    memcpy(iv, pIV, sizeof(iv));
+    MODIFY_REG(AES->CR, AES_CR_MODE | AES_CR_DATATYPE, CRYP_BYTE_SWAP);
+    WRITE_REG(AES->IVR3, __REV(iv[0]));
+    WRITE_REG(AES->IVR2, __REV(iv[1]));
+    WRITE_REG(AES->IVR1, __REV(iv[2]));
+    WRITE_REG(AES->IVR0, __REV(iv[3]));
+    SET_BIT(AES->CR, AES_CR_EN);
+
+    /* Same CBC encryption as the DA record, the session left it configured */
+    CLEAR_BIT(SAES_S->CR, AES_CR_MODE);
+    WRITE_REG(SAES_S->IVR3, a_aes_iv[0]);
+    WRITE_REG(SAES_S->IVR2, a_aes_iv[1]);
+    WRITE_REG(SAES_S->IVR1, a_aes_iv[2]);
+    WRITE_REG(SAES_S->IVR0, a_aes_iv[3]);
+    SET_BIT(SAES_S->CR, AES_CR_EN);
+  }
+
+  for (uint32_t offset = 0U; (ret == PROV_OK) && (offset < Length); offset += 16U)
+  {
+    memcpy(block, &pInput[offset], sizeof(block));
+    for (uint32_t i = 0U; i < 4U; i++)
+    {
+      WRITE_REG(AES->DINR, block[i]);
+    }
+    ret = Transport_WaitBlock(AES);
+
+    if (ret == PROV_OK)
+    {
+      /* Plain words only go through a CPU register */
+      for (uint32_t i = 0U; i < 4U; i++)
+      {
+        WRITE_REG(SAES_S->DINR, READ_REG(AES->DOUTR));
+      }
+      WRITE_REG(AES->ICR, AES_ICR_CCF);
+      ret = Transport_WaitBlock(SAES_S);
+    }
+
+    if (ret == PROV_OK)
+    {
+      for (uint32_t i = 0U; i < 4U; i++)
+      {
+        pOutput[(offset / 4U) + i] = READ_REG(SAES_S->DOUTR);
+      }
+      WRITE_REG(SAES_S->ICR, AES_ICR_CCF);
+    }
+  }
+
+  /* Both resets clear the data and key registers */
+  SAESSession_Close(&seal);
+  OemKey_Unload(&hcryp);
+
+  if (ret != PROV_OK)
+  {
+    memset(pOutput, 0x00, Length);
+  }
+  return ret;
+}
@@ -0,0 +1,15 @@
+#ifndef OBK_TRANSPORT_H
+#define OBK_TRANSPORT_H
+#include "obk_provisioning.h"
+
+/* .obk file encrypted by Tools/obk_transport.py : .obk header (clear), IV,
+   payload in AES-256-CTR under the transport key, SHA256 of all of it. The
+   transport key is an OEM key provisioned with OEM_KEY_USE_AES. */
+#define OBK_TRANSPORT_IV_SIZE     (16U)
+#define OBK_TRANSPORT_SIZE(n)     (sizeof(OBK_Header_t) + OBK_TRANSPORT_IV_SIZE + (n) + OBK_SHA256_LENGTH)
+
+int32_t OBKTransport_Check(const uint8_t *pFile, uint32_t Size);
+int32_t OBKTransport_Reencrypt(uint16_t KeyId, const uint8_t *pIV, const uint8_t *pInput, uint32_t Length,
+                               uint32_t *pOutput);
+
+#endif
@@ -0,0 +1,281 @@
+#include "oem_key.h"
+#include "secure_utils.h"
+#include "string.h"
+#include "Keys_Config.h"
+
+#define OEM_KEY_TIMEOUT           (100U)
+#define OEM_KEY_ID_MASK           (0xFF00U)
+
+/* Key of Keys_Config.h */
+typedef struct {
+    uint16_t Id;
+    uint32_t Usage;
+    uint32_t KeySize;
+    uint32_t Key[8];
+  } OemKey_Config_t;
+
+/* SAES keyed with the DHUK to wrap or share a key */
+static CRYP_HandleTypeDef hcryp_dhuk;
+
+/**
+  * @brief  Configure SAES with the DHUK for a key operation
+  * @note   The OBK DHUK session is suspended first, it configures SAES
+  *         again on its next access.
+  * @param  hcryp Handle to initialize
+  * @param  KeyMode CRYP_KEYMODE_WRAPPED or CRYP_KEYMODE_SHARED
+  * @param  KeySize Size of the OEM key
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef OemKey_InitDHUK(CRYP_HandleTypeDef *hcryp, uint32_t KeyMode, uint32_t KeySize)
+{
+  (void) OBKProvisioning_SuspendCryptoSession();
+
+  __HAL_RCC_SBS_CLK_ENABLE();
+  __HAL_RCC_SAES_CLK_ENABLE();
+
+  /* Force use of EPOCH_S value for DHUK */
+  WRITE_REG(SBS_S->EPOCHSELCR, SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH);
+
+  memset(hcryp, 0x00, sizeof(CRYP_HandleTypeDef));
+  hcryp->Instance = SAES_S;
+  hcryp->Init.DataType = CRYP_NO_SWAP;
+  hcryp->Init.KeySelect = CRYP_KEYSEL_HW;
+  hcryp->Init.Algorithm = CRYP_AES_ECB;
+  hcryp->Init.KeyMode = KeyMode;
+  hcryp->Init.KeySize = KeySize;
+  hcryp->Init.KeyIVConfigSkip = CRYP_KEYIVCONFIG_ALWAYS;
+
+  return HAL_CRYP_Init(hcryp);
+}
+
+/**
+  * @brief  Wrap an OEM AES key with the DHUK and store it in OBK
+  * @note   The key is encrypted inside SAES, only the wrapped key is written
+  *         to OBK and registered in the OBK directory. A key already stored
+  *         with this ID is replaced.
+  * @param  Id Key ID, in [OBK_DIR_ID_OEM_KEY, OBK_DIR_ID_OEM_KEY + 0xFF]
+  * @param  Usage OEM_KEY_USE_SAES or OEM_KEY_USE_AES
+  * @param  pKey Plain key
+  * @param  KeySize CRYP_KEYSIZE_128B or CRYP_KEYSIZE_256B
+  * @retval PROV_OK, Prov_Status_t error otherwise
+  */
+int32_t OemKey_Provision(uint16_t Id, uint32_t Usage, const uint32_t *pKey, uint32_t KeySize)
+{
+  OemKey_Record_t record = {0U};
+  OBK_Record_t obk;
+  HAL_StatusTypeDef status;
+  int32_t ret;
+
+  if ((pKey == NULL) || ((Id & OEM_KEY_ID_MASK) != OBK_DIR_ID_OEM_KEY) || (Usage > OEM_KEY_USE_AES) ||
+      ((KeySize != CRYP_KEYSIZE_128B) && (KeySize != CRYP_KEYSIZE_256B)))
+  {
+    return PROV_ERR_PARAM;
+  }
+
+  record.Usage = Usage;
+  record.KeySize = KeySize;
+
+  if (Usage == OEM_KEY_USE_SAES)
+  {
+    status = OemKey_InitDHUK(&hcryp_dhuk, CRYP_KEYMODE_WRAPPED, KeySize);
+    if (status == HAL_OK)
+    {
+      status = HAL_CRYPEx_WrapKey(&hcryp_dhuk, (uint32_t *)pKey, record.Wrapped, OEM_KEY_TIMEOUT);
+    }
+  }
+  else
+  {
+    status = OemKey_InitDHUK(&hcryp_dhuk, CRYP_KEYMODE_SHARED, KeySize);
+    if (status == HAL_OK)
+    {
+      status = HAL_CRYPEx_EncryptSharedKey(&hcryp_dhuk, (uint32_t *)pKey, record.Wrapped, OEM_KEY_SHARE_ID,
+                                           OEM_KEY_TIMEOUT);
+    }
+  }
+  OemKey_Unload(&hcryp_dhuk);
+
+  if (status != HAL_OK)
+  {
+    return PROV_ERR_CRYPTO;
+  }
+
+  ret = OBKDirectory_Allocate(Id, sizeof(record), &obk.Header);
+  if (ret != PROV_OK)
+  {
+    (void) OBKDirectory_Load();
+    return ret;
+  }
+  obk.Header.encrypted = OBK_RECORD_PLAIN;
+  obk.pData = (const uint8_t *)&record;
+
+  ret = OBKDirectory_Commit(&obk, 1U);
+  if (ret == PROV_OK)
+  {
+    ret = OBKProvisioning_VerifyRecords(&obk, 1U);
+  }
+  return ret;
+}
+
+/**
+  * @brief  Provision OEM keys from Keys_Config.h
+  * @note   Keys_Config.h holds the plain keys : only a provisioning image is
+  *         built with it. Each key is loaded once written, the CPU cannot
+  *         read it back so a successful load is the check.
+  * @param  Id Key ID to provision, 0 for every configured key
+  * @retval PROV_OK, PROV_ERR_STATE if a given Id is not configured,
+  *         Prov_Status_t error otherwise
+  */
+int32_t OemKey_ProvisionConfig(uint16_t Id)
+{
+#if (KEYS_CONFIG_OEM_COUNT != 0U)
+  static const OemKey_Config_t config[KEYS_CONFIG_OEM_COUNT] = { KEYS_CONFIG_OEM };
+  CRYP_HandleTypeDef hcryp = {0};
+  int32_t ret = PROV_ERR_STATE;
+
+  for (uint32_t i = 0U; i < KEYS_CONFIG_OEM_COUNT; i++)
+  {
+    if ((Id != 0U) && (config[i].Id != Id))
+    {
+      continue;
+    }
+
+    ret = OemKey_Provision(config[i].Id, config[i].Usage, config[i].Key, config[i].KeySize);
+    if (ret == PROV_OK)
+    {
+      ret = OemKey_Load(config[i].Id, &hcryp, CRYP_AES_ECB, NULL);
+      OemKey_Unload(&hcryp);
+    }
+    PRINTF("OEM key 0x%04x provisioned : %s\r\n", config[i].Id, Prov_StatusName((Prov_Status_t)ret));
+    if (ret != PROV_OK)
+    {
+      break;
+    }
+  }
+  return ret;
+#else
+  PRINTF("No OEM key in Keys_Config.h\r\n");
+  return (Id == 0U) ? PROV_OK : PROV_ERR_STATE;
+#endif
+}
+
+/**
+  * @brief  Load an OEM key into the AES accelerator it was provisioned for
+  * @note   The key is decrypted by SAES straight into key registers, it is
+  *         never readable by the CPU. hcryp is then ready for HAL_CRYP_Encrypt,
+  *         HAL_CRYP_Decrypt or their DMA variants :
+  *         - OEM_KEY_USE_SAES : hcryp drives SAES with the unwrapped key. SAES
+  *           is owned by the caller until OemKey_Unload(), OBK accesses must
+  *           not be interleaved.
+  *         - OEM_KEY_USE_AES : SAES shares the key with the AES peripheral and
+  *           is released, hcryp drives AES.
+  * @param  Id Key ID
+  * @param  hcryp Handle to initialize
+  * @param  Algorithm CRYP_AES_ECB, CRYP_AES_CBC or CRYP_AES_CTR
+  * @param  pInitVect Initialization vector, NULL for ECB
+  * @retval PROV_OK, PROV_ERR_STATE if the key is not provisioned,
+  *         PROV_ERR_CRYPTO on SAES or AES error, error status of
+  *         OBKProvisioning_Read() otherwise
+  */
+int32_t OemKey_Load(uint16_t Id, CRYP_HandleTypeDef *hcryp, uint32_t Algorithm, uint32_t *pInitVect)
+{
+  const OBK_DirEntry_t *pEntry = OBKDirectory_Find(Id);
+  OemKey_Record_t record;
+  CRYP_ConfigTypeDef config;
+  HAL_StatusTypeDef status = HAL_ERROR;
+  uint32_t tickstart;
+  int32_t ret;
+
+  if (hcryp == NULL)
+  {
+    return PROV_ERR_PARAM;
+  }
+  if ((pEntry == NULL) || (pEntry->Length != sizeof(record)))
+  {
+    return PROV_ERR_STATE;
+  }
+  memset(hcryp, 0x00, sizeof(CRYP_HandleTypeDef));
+  ret = OBKProvisioning_Read(pEntry->Offset, &record, sizeof(record), OBK_RECORD_PLAIN);
+  if (ret != PROV_OK)
+  {
+    return ret;
+  }
+
+  if (record.Usage == OEM_KEY_USE_SAES)
+  {
+    status = OemKey_InitDHUK(hcryp, CRYP_KEYMODE_WRAPPED, record.KeySize);
+    if (status == HAL_OK)
+    {
+      status = HAL_CRYPEx_UnwrapKey(hcryp, record.Wrapped, OEM_KEY_TIMEOUT);
+    }
+    if (status == HAL_OK)
+    {
+      status = HAL_CRYP_GetConfig(hcryp, &config);
+    }
+    if (status == HAL_OK)
+    {
+      /* Key registers hold the unwrapped key, they must not be written again */
+      config.Algorithm = Algorithm;
+      config.pInitVect = pInitVect;
+      config.KeyMode = CRYP_KEYMODE_NORMAL;
+      config.KeySelect = CRYP_KEYSEL_NORMAL;
+      config.KeyIVConfigSkip = CRYP_KEYNOCONFIG;
+      status = HAL_CRYP_SetConfig(hcryp, &config);
+    }
+  }
+  else if (record.Usage == OEM_KEY_USE_AES)
+  {
+    status = OemKey_InitDHUK(&hcryp_dhuk, CRYP_KEYMODE_SHARED, record.KeySize);
+    if (status == HAL_OK)
+    {
+      status = HAL_CRYPEx_DecryptSharedKey(&hcryp_dhuk, record.Wrapped, OEM_KEY_SHARE_ID, OEM_KEY_TIMEOUT);
+    }
+    if (status == HAL_OK)
+    {
+      /* KMOD set to shared by the init : AES fetches the key from SAES */
+      __HAL_RCC_AES_CLK_ENABLE();
+      memset(hcryp, 0x00, sizeof(CRYP_HandleTypeDef));
+      hcryp->Instance = AES;
+      hcryp->Init.DataType = CRYP_NO_SWAP;
+      hcryp->Init.Algorithm = Algorithm;
+      hcryp->Init.KeyMode = CRYP_KEYMODE_SHARED;
+      hcryp->Init.KeySize = record.KeySize;
+      hcryp->Init.pInitVect = pInitVect;
+      hcryp->Init.KeyIVConfigSkip = CRYP_KEYIVCONFIG_ALWAYS;
+      status = HAL_CRYP_Init(hcryp);
+    }
+    tickstart = HAL_GetTick();
+    while ((status == HAL_OK) && (READ_BIT(hcryp->Instance->SR, AES_SR_KEYVALID) == 0U))
+    {
+      if ((HAL_GetTick() - tickstart) > OEM_KEY_TIMEOUT)
+      {
+        status = HAL_TIMEOUT;
+      }
+    }
+    OemKey_Unload(&hcryp_dhuk);
+  }
+
+  SecureUtils_Zeroize(&record, sizeof(record));
+  if (status != HAL_OK)
+  {
+    OemKey_Unload(hcryp);
+    return PROV_ERR_CRYPTO;
+  }
+  return PROV_OK;
+}
+
+/**
+  * @brief  Clear a loaded key and release the accelerator
+  * @note   HAL_CRYP_DeInit() resets the peripheral, clearing its key registers.
+  * @param  hcryp Handle initialized by OemKey_Load()
+  * @retval None
+  */
+void OemKey_Unload(CRYP_HandleTypeDef *hcryp)
+{
+  if ((hcryp == NULL) || (hcryp->Instance == NULL))
+  {
+    return;
+  }
+
+  (void) HAL_CRYP_DeInit(hcryp);
+  SecureUtils_Zeroize(hcryp, sizeof(CRYP_HandleTypeDef));
+}
@@ -0,0 +1,24 @@
+#ifndef OEM_KEY_H
+#define OEM_KEY_H
+#include "obk_directory.h"
+
+/* Where a key is loaded at run time, chosen at provisioning */
+#define OEM_KEY_USE_SAES          (0U)      /* Unwrapped into the SAES key registers */
+#define OEM_KEY_USE_AES           (1U)      /* Shared with the AES peripheral over the key bus */
+
+#define OEM_KEY_SHARE_ID          CRYP_KSHAREID_AES
+
+/* OBK record of an OEM key, plain : the key itself is wrapped with the DHUK */
+typedef struct {
+    uint32_t Usage;       /* OEM_KEY_USE_xxx */
+    uint32_t KeySize;     /* CRYP_KEYSIZE_128B or CRYP_KEYSIZE_256B */
+    uint32_t Reserved[2];
+    uint32_t Wrapped[8];  /* Key encrypted by SAES in wrapped or shared key mode */
+  } OemKey_Record_t;
+
+int32_t OemKey_Provision(uint16_t Id, uint32_t Usage, const uint32_t *pKey, uint32_t KeySize);
+int32_t OemKey_ProvisionConfig(uint16_t Id);
+int32_t OemKey_Load(uint16_t Id, CRYP_HandleTypeDef *hcryp, uint32_t Algorithm, uint32_t *pInitVect);
+void OemKey_Unload(CRYP_HandleTypeDef *hcryp);
+
+#endif
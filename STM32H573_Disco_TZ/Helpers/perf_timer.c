@@ -0,0 +1,46 @@
+#include "perf_timer.h"
+
+/**
+  * @brief  Enable the DWT cycle counter
+  * @retval None
+  */
+void PerfTimer_Init(void)
+{
+  if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+  {
+    DCB->DEMCR |= DCB_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+}
+
+/**
+  * @brief  Start a measurement
+  * @retval Cycle counter value to be given to PerfTimer_Elapsed*()
+  */
+uint32_t PerfTimer_Start(void)
+{
+  PerfTimer_Init();
+  return DWT->CYCCNT;
+}
+
+/**
+  * @brief  Cycles elapsed since PerfTimer_Start()
+  * @note   Wraps after 2^32 cycles (17 s at 250 MHz).
+  * @param  Start Value returned by PerfTimer_Start()
+  * @retval Number of cycles
+  */
+uint32_t PerfTimer_ElapsedCycles(uint32_t Start)
+{
+  return DWT->CYCCNT - Start;
+}
+
+/**
+  * @brief  Microseconds elapsed since PerfTimer_Start()
+  * @param  Start Value returned by PerfTimer_Start()
+  * @retval Number of microseconds
+  */
+uint32_t PerfTimer_ElapsedUs(uint32_t Start)
+{
+  return PerfTimer_ElapsedCycles(Start) / (SystemCoreClock / 1000000U);
+}
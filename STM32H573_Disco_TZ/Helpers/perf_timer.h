@@ -0,0 +1,10 @@
+#ifndef PERF_TIMER_H
+#define PERF_TIMER_H
+#include "main.h"
+
+void PerfTimer_Init(void);
+uint32_t PerfTimer_Start(void);
+uint32_t PerfTimer_ElapsedCycles(uint32_t Start);
+uint32_t PerfTimer_ElapsedUs(uint32_t Start);
+
+#endif
@@ -1,29 +1,194 @@
 #include "product_state.h"
 
-#ifdef DEBUG
+#include "obk_directory.h"
+#include "ob_config.h"
+#include "prov_result.h"
+
+#define PS_OPEN                   (0U)
+#define PS_IROT_PROVISIONED       (1U)
+#define PS_PROVISIONING           (2U)
+#define PS_TZ_CLOSED              (3U)
+#define PS_CLOSED                 (4U)
+#define PS_LOCKED                 (5U)
+#define PS_COUNT                  (6U)
+#define PS_BIT(i)                 (1U << (i))
+
 typedef struct
 {
-	uint8_t id;
-	char name[15];
+	uint32_t state;   /* OB_PROD_STATE_xxx */
+	const char *name;
+	uint32_t next;    /* PS_BIT() of the states reachable with one OB launch */
+	uint32_t checks;  /* PRODUCT_STATE_CHECK_xxx needed to enter the state */
 }sProdState;
 
-sProdState ProdStates[] = {
-		{ 0xED, "OPEN" },
-		{ 0x17, "PROVISIONING" },
-		{ 0x17, "PROVISIONING" },
-		{ 0x2E, "PROVISIONED" },
-		{ 0xC6, "TZ-CLOSED" },
-		{ 0x72, "CLOSED" },
-		{ 0x5C, "LOCKED" }
+/* Forward transitions only, going back is a regression through DA.
+   iROT-PROVISIONED comes before PROVISIONING so that it is preferred on
+   paths of equal length : in PROVISIONING the device boots on the ST
+   bootloader and this firmware cannot carry on. */
+static const sProdState ProdStates[PS_COUNT] = {
+	{ OB_PROD_STATE_OPEN,             "OPEN",
+	  PS_BIT(PS_PROVISIONING) | PS_BIT(PS_IROT_PROVISIONED),
+	  0U },
+	{ OB_PROD_STATE_IROT_PROVISIONED, "iROT-PROVISIONED",
+	  PS_BIT(PS_TZ_CLOSED) | PS_BIT(PS_CLOSED) | PS_BIT(PS_LOCKED),
+	  PRODUCT_STATE_CHECK_BOOT_UBE },
+	{ OB_PROD_STATE_PROVISIONING,     "PROVISIONING",
+	  PS_BIT(PS_IROT_PROVISIONED) | PS_BIT(PS_TZ_CLOSED) | PS_BIT(PS_CLOSED) | PS_BIT(PS_LOCKED),
+	  0U },
+	{ OB_PROD_STATE_TZ_CLOSED,        "TZ-CLOSED",
+	  PS_BIT(PS_CLOSED) | PS_BIT(PS_LOCKED),
+	  PRODUCT_STATE_CHECK_BOOT_UBE | PRODUCT_STATE_CHECK_TZEN },
+	{ OB_PROD_STATE_CLOSED,           "CLOSED",
+	  PS_BIT(PS_LOCKED),
+	  PRODUCT_STATE_CHECK_BOOT_UBE | PRODUCT_STATE_CHECK_TZEN },
+	{ OB_PROD_STATE_LOCKED,           "LOCKED",
+	  0U,
+	  PRODUCT_STATE_CHECK_BOOT_UBE | PRODUCT_STATE_CHECK_TZEN | PRODUCT_STATE_CHECK_DA | PRODUCT_STATE_CHECK_LOCK },
 };
-#endif
 
-void ProductState_Set(uint32_t prodState)
+/**
+  * @brief  Index of a product state in ProdStates
+  * @param  prodState OB_PROD_STATE_xxx
+  * @retval Index, PS_COUNT if unknown
+  */
+static uint32_t ProductState_Index(uint32_t prodState)
+{
+	uint32_t i;
+
+	for (i = 0U; i < PS_COUNT; i++)
+	{
+		if (ProdStates[i].state == prodState)
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+/**
+  * @brief  Name of a product state
+  * @param  prodState OB_PROD_STATE_xxx
+  * @retval Name, "UNKNOWN" if not a product state
+  */
+const char *ProductState_Name(uint32_t prodState)
+{
+	uint32_t i = ProductState_Index(prodState);
+
+	return (i < PS_COUNT) ? ProdStates[i].name : "UNKNOWN";
+}
+
+/**
+  * @brief  Compute the shortest path between two product states
+  * @note   Each step is one OB launch. Preconditions of every state on the
+  *         path are collected in pPlan->Checks. Nothing is read or written.
+  * @param  Current Current OB_PROD_STATE_xxx
+  * @param  Target Target OB_PROD_STATE_xxx
+  * @param  pPlan Filled with the states to program, in order
+  * @retval PROV_OK if a path exists (Count 0 if already in the target),
+  *         PROV_ERR_PARAM if a state is unknown, PROV_ERR_STATE if the target
+  *         cannot be reached
+  */
+int32_t ProductState_Plan(uint32_t Current, uint32_t Target, ProductState_Plan_t *pPlan)
+{
+	uint32_t from = ProductState_Index(Current);
+	uint32_t to = ProductState_Index(Target);
+	uint32_t previous[PS_COUNT];
+	uint32_t queue[PS_COUNT];
+	uint32_t head = 0U;
+	uint32_t tail = 0U;
+	uint32_t visited;
+
+	pPlan->Count = 0U;
+	pPlan->Checks = 0U;
+	if ((from == PS_COUNT) || (to == PS_COUNT))
+	{
+		return PROV_ERR_PARAM;
+	}
+
+	/* Breadth first : fewest launches */
+	visited = PS_BIT(from);
+	queue[tail++] = from;
+	while ((head < tail) && ((visited & PS_BIT(to)) == 0U))
+	{
+		uint32_t i = queue[head++];
+
+		for (uint32_t j = 0U; j < PS_COUNT; j++)
+		{
+			if (((ProdStates[i].next & PS_BIT(j)) != 0U) && ((visited & PS_BIT(j)) == 0U))
+			{
+				visited |= PS_BIT(j);
+				previous[j] = i;
+				queue[tail++] = j;
+			}
+		}
+	}
+	if ((visited & PS_BIT(to)) == 0U)
+	{
+		return PROV_ERR_STATE;
+	}
+
+	for (uint32_t i = to; i != from; i = previous[i])
+	{
+		pPlan->Count++;
+	}
+	for (uint32_t i = to, n = pPlan->Count; i != from; i = previous[i])
+	{
+		pPlan->Steps[--n] = ProdStates[i].state;
+		pPlan->Checks |= ProdStates[i].checks;
+	}
+	return PROV_OK;
+}
+
+/**
+  * @brief  Check the preconditions of a plan against the device
+  * @param  pPlan Plan from ProductState_Plan()
+  * @retval PRODUCT_STATE_CHECK_xxx that fail, 0 if the plan can run
+  */
+uint32_t ProductState_Check(const ProductState_Plan_t *pPlan)
+{
+	uint32_t failed = 0U;
+
+	// Important : if BOOT_UBE is set to 0xC3 the device will boot on STiRoT when closed
+	// Here provisioning of only for OEMiRoT case
+	if (((pPlan->Checks & PRODUCT_STATE_CHECK_BOOT_UBE) != 0U) &&
+	    ((FLASH->OPTSR_CUR & FLASH_OPTSR_BOOT_UBE_Msk) != OB_UBE_OEM_IROT))
+	{
+		printf("Boot UBE not set properly : 0x%lx\r\n", (FLASH->OPTSR_CUR & FLASH_OPTSR_BOOT_UBE_Msk) >> FLASH_OPTSR_BOOT_UBE_Pos);
+		failed |= PRODUCT_STATE_CHECK_BOOT_UBE;
+	}
+	// DA credentials are encrypted with the DHUK, only usable with TrustZone
+	if (((pPlan->Checks & PRODUCT_STATE_CHECK_TZEN) != 0U) &&
+	    ((FLASH->OPTSR2_CUR & FLASH_OPTSR2_TZEN) != OB_TZEN_ENABLE))
+	{
+		printf("TrustZone not enabled\r\n");
+		failed |= PRODUCT_STATE_CHECK_TZEN;
+	}
+	if (((pPlan->Checks & PRODUCT_STATE_CHECK_DA) != 0U) && (OBKDirectory_Find(OBK_DIR_ID_DA) == NULL))
+	{
+		printf("DA credentials not provisioned\r\n");
+		failed |= PRODUCT_STATE_CHECK_DA;
+	}
+	if (((pPlan->Checks & PRODUCT_STATE_CHECK_LOCK) != 0U) && (PRODUCT_STATE_ALLOW_LOCKED == 0U))
+	{
+		printf("LOCKED is final, not enabled in this build\r\n");
+		failed |= PRODUCT_STATE_CHECK_LOCK;
+	}
+	return failed;
+}
+
+/* An option byte modification left busy or interrupted is retried */
+static const ProvRetry_Policy_t ProductState_RetryPolicy = PROV_RETRY_FLASH;
+
+/**
+  * @brief  Program a product state and launch it, one attempt
+  * @param  pArg OB_PROD_STATE_xxx to program
+  * @retval Result
+  */
+static Prov_Result_t ProductState_SetStep(void *pArg)
 {
   FLASH_OBProgramInitTypeDef flash_option_bytes_bank1 = {0};
   HAL_StatusTypeDef ret = HAL_ERROR;
-
-  PRINTF("Setting product state to 0x%lx ...\r\n", prodState >> FLASH_OPTSR_PRODUCT_STATE_Pos);
+  Prov_Result_t result = Prov_Ok();
 
    /* Unlock the Flash to enable the flash control register access */
   HAL_FLASH_Unlock();
@@ -32,83 +197,139 @@ void ProductState_Set(uint32_t prodState)
   HAL_FLASH_OB_Unlock();
 
   flash_option_bytes_bank1.OptionType = OPTIONBYTE_PROD_STATE;
-  flash_option_bytes_bank1.ProductState = prodState;
+  flash_option_bytes_bank1.ProductState = *(const uint32_t *)pArg;
 
   PRINTF("Program state ...\r\n");
 
   ret = HAL_FLASHEx_OBProgram(&flash_option_bytes_bank1);
   if (ret != HAL_OK)
   {
-	  printf("Error while setting OB Bank1 config state %ld : %d\r\n", prodState, ret);
-	  while(1);
+    result = Prov_Fail(PROV_ERR_OB_PROGRAM, ret);
   }
-
-  PRINTF("OB Launch ...\r\n");
-
-  /* Launch the Options Bytes (reset the board, should not return) */
-  ret = HAL_FLASH_OB_Launch();
-  if (ret != HAL_OK)
+  else
   {
-    printf("Error while execution OB_Launch : %d\r\n", ret);
-    while(1);
+    PRINTF("OB Launch ...\r\n");
+
+    /* Launch the Options Bytes (reset the board, should not return) */
+    ret = HAL_FLASH_OB_Launch();
+    if (ret != HAL_OK)
+    {
+      result = Prov_Fail(PROV_ERR_OB_LAUNCH, ret);
+    }
   }
+
+  HAL_FLASH_OB_Lock();
+  HAL_FLASH_Lock();
+
+  return result;
+}
+
+/**
+  * @brief  Program a product state
+  * @note   Transient flash errors are retried, a failure is returned to the
+  *         caller instead of halting so that the menu stays usable.
+  * @param  prodState OB_PROD_STATE_xxx
+  * @retval PROV_OK, Prov_Status_t otherwise
+  */
+int32_t ProductState_Set(uint32_t prodState)
+{
+  PRINTF("Setting product state to 0x%lx ...\r\n", prodState >> FLASH_OPTSR_PRODUCT_STATE_Pos);
+
+  return ProvRetry_Run(&ProductState_RetryPolicy, "Product state", ProductState_SetStep, &prodState);
 }
 
 
 uint32_t ProductState_Get(void)
 {
-	uint32_t productState= (FLASH->OPTSR_CUR & FLASH_OPTSR_PRODUCT_STATE_Msk) >> FLASH_OPTSR_PRODUCT_STATE_Pos;
-#ifdef DEBUG
-	for (uint32_t i=0; i< (sizeof (ProdStates) / sizeof (sProdState)); i++)
+	return (FLASH->OPTSR_CUR & FLASH_OPTSR_PRODUCT_STATE_Msk) >> FLASH_OPTSR_PRODUCT_STATE_Pos;
+}
+
+/**
+  * @brief  Move the device towards a product state
+  * @note   The path and its preconditions are checked before any option byte
+  *         is touched. One step is programmed per launch, the device resets
+  *         and the next call programs the following step.
+  * @param  Target OB_PROD_STATE_xxx
+  * @retval PROV_OK if already in the target state, PROV_ERR_STATE if it is
+  *         unreachable or a precondition fails, error status of
+  *         ProductState_Plan() or ProductState_Set() otherwise
+  */
+int32_t ProductState_Goto(uint32_t Target)
+{
+	ProductState_Plan_t plan;
+	uint32_t current = FLASH->OPTSR_CUR & FLASH_OPTSR_PRODUCT_STATE_Msk;
+	int32_t ret;
+
+	ret = ProductState_Plan(current, Target, &plan);
+	if (ret != PROV_OK)
 	{
-		if (productState == ProdStates[i].id)
-		{
-			printf("PRODUCT_STATE : %s\r\n", ProdStates[i].name);
-			return productState;
-		}
+		printf("No transition from %s to %s\r\n", ProductState_Name(current), ProductState_Name(Target));
+		return ret;
+	}
+	if (plan.Count == 0U)
+	{
+		PRINTF("Device already %s\r\n", ProductState_Name(Target));
+		return PROV_OK;
+	}
+	if (ProductState_Check(&plan) != 0U)
+	{
+		return PROV_ERR_STATE;
 	}
 
-	printf("Unknown PRODUCT_STATE : 0x%lx\r\n", productState);
-    return 0;
-#else
-    return productState;
-#endif
+	PRINTF("%s -> %s : %lu OB launch(es), now %s\r\n", ProductState_Name(current), ProductState_Name(Target),
+	       plan.Count, ProductState_Name(plan.Steps[0]));
+	ret = ProductState_Set(plan.Steps[0]);
+	if (ret != PROV_OK)
+	{
+		return ret;
+	}
+	PRINTF("Reset ...\r\n");
+	NVIC_SystemReset();
+	return PROV_OK;
 }
 
 void ProductState_Close(void)
 {
-	PRINTF("Close device. Check not already closed\r\n");
-	if ((FLASH->OPTSR_CUR & FLASH_OPTSR_PRODUCT_STATE_Msk) == OB_PROD_STATE_CLOSED)
+	PRINTF("Close device to %s\r\n", ProductState_Name(OB_CONFIG_PRODUCT_STATE));
+	if (ProductState_Goto(OB_CONFIG_PRODUCT_STATE) != PROV_OK)
 	{
-		PRINTF("Device Already closed\r\n");
-		return;
+		printf("Error while closing device\r\n");
 	}
+}
 
-	// Important : if BOOT_UBE is set to 0xC3 the device will boot on STiRoT when closed
-	// Here provisioning of only for OEMiRoT case
-	PRINTF("Close device. Check BOOT_UBE OB set for Flash boot\r\n");
-	if ((FLASH->OPTSR_CUR & FLASH_OPTSR_BOOT_UBE_Msk) != OB_UBE_OEM_IROT)
+void ProductState_Regression(void)
+{
+	PRINTF("Launching regression ...\r\n");
+	if (ProductState_Set(OB_PROD_STATE_REGRESSION) != PROV_OK)
 	{
-		printf("Boot UBE not set properly : 0x%lx\r\n", (FLASH->OPTSR_CUR & FLASH_OPTSR_BOOT_UBE_Msk) >> FLASH_OPTSR_BOOT_UBE_Pos);
+		printf("Error while launching regression\r\n");
 		return;
 	}
-	else
-	{
-		PRINTF("Boot UBE set properly : 0x%lx\r\n", (FLASH->OPTSR_CUR & FLASH_OPTSR_BOOT_UBE_Msk)  >> FLASH_OPTSR_BOOT_UBE_Pos);
-	}
-
-	PRINTF("Move to iROT Provisioned ...\r\n");
-	ProductState_Set(OB_PROD_STATE_IROT_PROVISIONED);
-	PRINTF("Move to Closed ...\r\n");
-	ProductState_Set(OB_PROD_STATE_CLOSED);
 	PRINTF("Reset ...\r\n");
 	NVIC_SystemReset();
 }
 
-void ProductState_Regression(void)
+/**
+  * @brief  Non secure regression from TZ-CLOSED
+  * @note   Only the non secure flash is erased : secure image and OBK
+  *         contents, DA credentials included, are kept.
+  * @retval None
+  */
+void ProductState_NSRegression(void)
 {
-	PRINTF("Launching regression ...\r\n");
-	ProductState_Set(OB_PROD_STATE_REGRESSION);
+	uint32_t current = FLASH->OPTSR_CUR & FLASH_OPTSR_PRODUCT_STATE_Msk;
+
+	if (current != OB_PROD_STATE_TZ_CLOSED)
+	{
+		printf("Non secure regression needs TZ-CLOSED, device is %s\r\n", ProductState_Name(current));
+		return;
+	}
+	PRINTF("Launching non secure regression ...\r\n");
+	if (ProductState_Set(OB_PROD_STATE_NS_REGRESSION) != PROV_OK)
+	{
+		printf("Error while launching non secure regression\r\n");
+		return;
+	}
 	PRINTF("Reset ...\r\n");
 	NVIC_SystemReset();
 }
@@ -2,9 +2,33 @@
 #define PRODUCT_STATE_H
 #include "main.h"
 
-void ProductState_Set(uint32_t prodState);
+/* Preconditions to enter a product state */
+#define PRODUCT_STATE_CHECK_BOOT_UBE  (1U << 0)   /* Boot on OEM iRoT (user flash) */
+#define PRODUCT_STATE_CHECK_TZEN      (1U << 1)   /* TrustZone enabled */
+#define PRODUCT_STATE_CHECK_DA        (1U << 2)   /* DA credentials provisioned */
+#define PRODUCT_STATE_CHECK_LOCK      (1U << 3)   /* LOCKED allowed in this build */
+
+/* LOCKED cannot be left, not even with DA */
+#ifndef PRODUCT_STATE_ALLOW_LOCKED
+#define PRODUCT_STATE_ALLOW_LOCKED    (0U)
+#endif
+
+#define PRODUCT_STATE_MAX_PATH        (5U)
+
+typedef struct {
+    uint32_t Count;                           /* Number of OB launches */
+    uint32_t Steps[PRODUCT_STATE_MAX_PATH];   /* OB_PROD_STATE_xxx to program in order */
+    uint32_t Checks;                          /* PRODUCT_STATE_CHECK_xxx of the path */
+  } ProductState_Plan_t;
+
+int32_t ProductState_Set(uint32_t prodState);
 uint32_t ProductState_Get(void);
+const char *ProductState_Name(uint32_t prodState);
+int32_t ProductState_Plan(uint32_t Current, uint32_t Target, ProductState_Plan_t *pPlan);
+uint32_t ProductState_Check(const ProductState_Plan_t *pPlan);
+int32_t ProductState_Goto(uint32_t Target);
 void ProductState_Close(void);
 void ProductState_Regression(void);
+void ProductState_NSRegression(void);
 
 #endif
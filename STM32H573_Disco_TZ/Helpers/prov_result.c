@@ -0,0 +1,148 @@
+#include "prov_result.h"
+
+/* Flash errors that can clear on a new attempt : sequence errors left by an
+   interrupted operation. Write protection, OBK access and ECC errors are
+   permanent for the current state. */
+#define PROV_FLASH_TRANSIENT_ERRORS  (HAL_FLASH_ERROR_PGS | HAL_FLASH_ERROR_STRB | HAL_FLASH_ERROR_INC)
+
+static const char * const Prov_StatusNames[] = {
+  "OK", "invalid parameter", "wrong device state", "crypto error", "flash erase error",
+  "flash program error", "OBK swap error", "option byte program error", "option byte launch error",
+  "verify error", "retries exhausted"
+};
+
+static Prov_Result_t Prov_LastResult;
+
+/**
+  * @brief  Successful result
+  * @retval Result
+  */
+Prov_Result_t Prov_Ok(void)
+{
+  Prov_Result_t result = { PROV_OK, HAL_OK, HAL_FLASH_ERROR_NONE };
+
+  return result;
+}
+
+/**
+  * @brief  Build a failure result
+  * @note   The flash error flags of the last HAL flash operation are
+  *         captured, the result is kept for Prov_GetLastResult().
+  * @param  Status Failed step category
+  * @param  HalStatus HAL status returned by the failing call, HAL_OK if none
+  * @retval Result
+  */
+Prov_Result_t Prov_Fail(Prov_Status_t Status, HAL_StatusTypeDef HalStatus)
+{
+  Prov_Result_t result;
+
+  result.Status = Status;
+  result.HalStatus = HalStatus;
+  result.FlashError = HAL_FLASH_GetError();
+  Prov_LastResult = result;
+
+  return result;
+}
+
+/**
+  * @brief  Tell whether a new attempt may succeed
+  * @param  pResult Result of the failed attempt
+  * @retval 1 if transient, 0 if the failure must be reported at once
+  */
+uint32_t Prov_IsTransient(const Prov_Result_t *pResult)
+{
+  switch (pResult->Status)
+  {
+    case PROV_ERR_CRYPTO:
+      return (pResult->HalStatus == HAL_TIMEOUT) ? 1U : 0U;
+    case PROV_ERR_FLASH_ERASE:
+    case PROV_ERR_FLASH_PROGRAM:
+    case PROV_ERR_OBK_SWAP:
+    case PROV_ERR_OB_PROGRAM:
+    case PROV_ERR_OB_LAUNCH:
+      if ((pResult->HalStatus == HAL_TIMEOUT) || (pResult->HalStatus == HAL_BUSY))
+      {
+        return 1U;
+      }
+      return ((pResult->FlashError != HAL_FLASH_ERROR_NONE) &&
+              ((pResult->FlashError & ~PROV_FLASH_TRANSIENT_ERRORS) == 0U)) ? 1U : 0U;
+    default:
+      return 0U;
+  }
+}
+
+/**
+  * @brief  Printable name of a status
+  * @param  Status Status
+  * @retval Name
+  */
+const char *Prov_StatusName(Prov_Status_t Status)
+{
+  if ((uint32_t)Status < (sizeof(Prov_StatusNames) / sizeof(Prov_StatusNames[0])))
+  {
+    return Prov_StatusNames[Status];
+  }
+  return "unknown error";
+}
+
+/**
+  * @brief  Print a failure with its HAL and flash error detail
+  * @param  pStep Name of the step
+  * @param  pResult Result
+  * @retval None
+  */
+void Prov_Report(const char *pStep, const Prov_Result_t *pResult)
+{
+  printf("%s failed : %s (HAL %d, flash error 0x%08lx)\r\n", pStep, Prov_StatusName(pResult->Status),
+         pResult->HalStatus, pResult->FlashError);
+}
+
+/**
+  * @brief  Detail of the last failure
+  * @param  pResult Filled with the last result built by Prov_Fail()
+  * @retval None
+  */
+void Prov_GetLastResult(Prov_Result_t *pResult)
+{
+  *pResult = Prov_LastResult;
+}
+
+/**
+  * @brief  Run a step with bounded retries
+  * @note   Transient failures are retried after a backoff that doubles each
+  *         time, up to the policy's attempts. Hard failures are reported and
+  *         returned at once.
+  * @param  pPolicy Retry policy of the step
+  * @param  pStep Name of the step, for the report
+  * @param  Step Function running one attempt
+  * @param  pArg Argument of the step function
+  * @retval PROV_OK, the hard failure status or PROV_ERR_RETRY_EXHAUSTED
+  */
+Prov_Status_t ProvRetry_Run(const ProvRetry_Policy_t *pPolicy, const char *pStep, ProvRetry_Step_t Step, void *pArg)
+{
+  uint32_t backoff = pPolicy->BackoffMs;
+  Prov_Result_t result = Prov_Ok();
+
+  for (uint32_t attempt = 1U; attempt <= pPolicy->MaxAttempts; attempt++)
+  {
+    result = Step(pArg);
+    if (result.Status == PROV_OK)
+    {
+      return PROV_OK;
+    }
+
+    Prov_Report(pStep, &result);
+    if (Prov_IsTransient(&result) == 0U)
+    {
+      return result.Status;
+    }
+    if (attempt < pPolicy->MaxAttempts)
+    {
+      PRINTF("Retry %lu/%lu in %lu ms\r\n", attempt + 1U, pPolicy->MaxAttempts, backoff);
+      HAL_Delay(backoff);
+      backoff *= 2U;
+    }
+  }
+
+  return (pPolicy->MaxAttempts > 1U) ? PROV_ERR_RETRY_EXHAUSTED : result.Status;
+}
@@ -0,0 +1,46 @@
+#ifndef PROV_RESULT_H
+#define PROV_RESULT_H
+#include "main.h"
+
+/* Result of a provisioning step, shared by the helpers */
+typedef enum {
+  PROV_OK = 0,
+  PROV_ERR_PARAM,           /* Invalid argument or record */
+  PROV_ERR_STATE,           /* Device state does not allow the step */
+  PROV_ERR_CRYPTO,          /* SAES or HASH failure */
+  PROV_ERR_FLASH_ERASE,
+  PROV_ERR_FLASH_PROGRAM,
+  PROV_ERR_OBK_SWAP,
+  PROV_ERR_OB_PROGRAM,
+  PROV_ERR_OB_LAUNCH,
+  PROV_ERR_VERIFY,          /* Read back differs from what was written */
+  PROV_ERR_RETRY_EXHAUSTED  /* Transient failure that did not recover */
+} Prov_Status_t;
+
+/* Detail of a failure, with the flash error flags collected by the HAL */
+typedef struct {
+    Prov_Status_t Status;
+    HAL_StatusTypeDef HalStatus;
+    uint32_t FlashError;    /* HAL_FLASH_GetError() when the step failed */
+  } Prov_Result_t;
+
+/* Bounded retry of a step, the backoff doubles after each attempt */
+typedef struct {
+    uint32_t MaxAttempts;
+    uint32_t BackoffMs;     /* Wait before the second attempt */
+  } ProvRetry_Policy_t;
+
+#define PROV_RETRY_FLASH          { 3U, 5U }
+#define PROV_RETRY_NONE           { 1U, 0U }
+
+typedef Prov_Result_t (*ProvRetry_Step_t)(void *pArg);
+
+Prov_Result_t Prov_Ok(void);
+Prov_Result_t Prov_Fail(Prov_Status_t Status, HAL_StatusTypeDef HalStatus);
+uint32_t Prov_IsTransient(const Prov_Result_t *pResult);
+const char *Prov_StatusName(Prov_Status_t Status);
+void Prov_Report(const char *pStep, const Prov_Result_t *pResult);
+void Prov_GetLastResult(Prov_Result_t *pResult);
+Prov_Status_t ProvRetry_Run(const ProvRetry_Policy_t *pPolicy, const char *pStep, ProvRetry_Step_t Step, void *pArg);
+
+#endif
@@ -0,0 +1,493 @@
+#include "saes_session.h"
+#include "secure_utils.h"
+
+#define SAES_SESSION_TIMEOUT      (100U)
+
+DMA_HandleTypeDef hdma_saes_in;
+DMA_HandleTypeDef hdma_saes_out;
+
+/* Session the GPDMA1 channels are linked to, NULL when not configured */
+static SAES_Session_t *DmaOwner = NULL;
+
+/**
+  * @brief  Configure one GPDMA1 channel for SAES
+  * @param  hdma DMA handle
+  * @param  Instance GPDMA1 channel
+  * @param  Request SAES_IN or SAES_OUT request
+  * @param  Direction Memory to SAES or SAES to memory
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef SAES_DMA_Init(DMA_HandleTypeDef *hdma, DMA_Channel_TypeDef *Instance, uint32_t Request,
+                                       uint32_t Direction)
+{
+  hdma->Instance = Instance;
+  hdma->Init.Request = Request;
+  hdma->Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+  hdma->Init.Direction = Direction;
+  hdma->Init.SrcInc = (Direction == DMA_MEMORY_TO_PERIPH) ? DMA_SINC_INCREMENTED : DMA_SINC_FIXED;
+  hdma->Init.DestInc = (Direction == DMA_MEMORY_TO_PERIPH) ? DMA_DINC_FIXED : DMA_DINC_INCREMENTED;
+  hdma->Init.SrcDataWidth = DMA_SRC_DATAWIDTH_WORD;
+  hdma->Init.DestDataWidth = DMA_DEST_DATAWIDTH_WORD;
+  hdma->Init.Priority = DMA_LOW_PRIORITY_HIGH_WEIGHT;
+  hdma->Init.SrcBurstLength = 1;
+  hdma->Init.DestBurstLength = 1;
+  hdma->Init.TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0 | DMA_DEST_ALLOCATED_PORT1;
+  hdma->Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+  hdma->Init.Mode = DMA_NORMAL;
+  if (HAL_DMA_Init(hdma) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+
+  /* Secure channel moving data between secure SRAM and SAES */
+  return HAL_DMA_ConfigChannelAttributes(hdma, DMA_CHANNEL_SEC | DMA_CHANNEL_SRC_SEC | DMA_CHANNEL_DEST_SEC);
+}
+
+/**
+  * @brief  Release the GPDMA1 channels if a session owns them
+  * @param  pSession Session giving the channels back
+  * @retval None
+  */
+static void SAES_DMA_Detach(SAES_Session_t *pSession)
+{
+  if ((DmaOwner == NULL) || (DmaOwner != pSession))
+  {
+    return;
+  }
+
+  HAL_NVIC_DisableIRQ(GPDMA1_Channel6_IRQn);
+  HAL_NVIC_DisableIRQ(GPDMA1_Channel7_IRQn);
+  (void) HAL_DMA_DeInit(&hdma_saes_in);
+  (void) HAL_DMA_DeInit(&hdma_saes_out);
+  DmaOwner = NULL;
+}
+
+/**
+  * @brief  Configure GPDMA1 channels 6 (SAES_IN) and 7 (SAES_OUT) for a session
+  * @note   A session opened in between may have taken the channels, they are
+  *         configured again and linked to this session's handle.
+  * @param  pSession Session running DMA operations
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef SAES_DMA_Attach(SAES_Session_t *pSession)
+{
+  if (DmaOwner == pSession)
+  {
+    return HAL_OK;
+  }
+  SAES_DMA_Detach(DmaOwner);
+
+  __HAL_RCC_GPDMA1_CLK_ENABLE();
+  if ((SAES_DMA_Init(&hdma_saes_in, GPDMA1_Channel6, GPDMA1_REQUEST_SAES_IN, DMA_MEMORY_TO_PERIPH) != HAL_OK) ||
+      (SAES_DMA_Init(&hdma_saes_out, GPDMA1_Channel7, GPDMA1_REQUEST_SAES_OUT, DMA_PERIPH_TO_MEMORY) != HAL_OK))
+  {
+    return HAL_ERROR;
+  }
+  __HAL_LINKDMA(&pSession->hcryp, hdmain, hdma_saes_in);
+  __HAL_LINKDMA(&pSession->hcryp, hdmaout, hdma_saes_out);
+
+  HAL_NVIC_SetPriority(GPDMA1_Channel6_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(GPDMA1_Channel6_IRQn);
+  HAL_NVIC_SetPriority(GPDMA1_Channel7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(GPDMA1_Channel7_IRQn);
+  DmaOwner = pSession;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Reset SAES and configure it with the DHUK for a session
+  * @param  pSession Session to configure
+  * @param  pInitVect CBC initialization vector restored before each operation
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef SAES_Configure(SAES_Session_t *pSession, const uint32_t *pInitVect)
+{
+  __HAL_RCC_SBS_CLK_ENABLE();
+  __HAL_RCC_SAES_CLK_ENABLE();
+
+  /* Force use of EPOCH_S value for DHUK */
+  WRITE_REG(SBS_S->EPOCHSELCR, SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH);
+
+  /* Configure SAES parameters */
+  pSession->hcryp.Instance = SAES_S;
+  if (HAL_CRYP_DeInit(&pSession->hcryp) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+  pSession->hcryp.Init.DataType = CRYP_NO_SWAP;
+  pSession->hcryp.Init.KeySelect = CRYP_KEYSEL_HW;        /* Hardware key : derived hardware unique key (DHUK 256-bit) */
+  pSession->hcryp.Init.Algorithm = CRYP_AES_CBC;
+  pSession->hcryp.Init.KeyMode = CRYP_KEYMODE_NORMAL ;
+  pSession->hcryp.Init.KeySize = CRYP_KEYSIZE_256B;       /* 256 bits AES Key */
+  pSession->hcryp.Init.pInitVect = (uint32_t *)pInitVect;
+  pSession->hcryp.Init.KeyIVConfigSkip = CRYP_KEYIVCONFIG_ALWAYS; /* Each operation restarts from pInitVect */
+
+  if ((HAL_CRYP_Init(&pSession->hcryp) != HAL_OK) || (SAES_DMA_Attach(pSession) != HAL_OK))
+  {
+    return HAL_ERROR;
+  }
+  return HAL_OK;
+}
+
+/**
+  * @brief  Open a SAES session keyed with the DHUK
+  * @note   The EPOCH selection, SAES init and hardware key load are done here
+  *         once, subsequent operations only reload the IV.
+  * @param  pSession Session to open
+  * @param  pInitVect CBC initialization vector restored before each operation
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_Open(SAES_Session_t *pSession, const uint32_t *pInitVect)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_CLOSED))
+  {
+    return HAL_ERROR;
+  }
+
+  if (SAES_Configure(pSession, pInitVect) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+
+  pSession->State = SAES_SESSION_OPEN;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Encrypt a buffer within an open session
+  * @param  pSession Open session
+  * @param  pInput Plain data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Encrypted data (aligned on 4 bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_Encrypt(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) || ((Length % 16U) != 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  /* Size is n words */
+  return HAL_CRYP_Encrypt(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput,
+                          SAES_SESSION_TIMEOUT);
+}
+
+/**
+  * @brief  Decrypt a buffer within an open session
+  * @param  pSession Open session
+  * @param  pInput Encrypted data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Plain data (aligned on 4 bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_Decrypt(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) || ((Length % 16U) != 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  /* Size is n words */
+  return HAL_CRYP_Decrypt(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput,
+                          SAES_SESSION_TIMEOUT);
+}
+
+/**
+  * @brief  Run one AES-GCM operation with the session key
+  * @note   The session is switched to GCM for this call only, the CBC
+  *         configuration is restored afterwards. The 96-bit IV is completed
+  *         into the initial counter block (last word 2) as GCM requires.
+  * @param  pSession Open session
+  * @param  Encrypt 1 to encrypt, 0 to decrypt
+  * @param  pIV 96-bit IV (3 words)
+  * @param  pHeader Additional authenticated data (aligned on 4 bytes)
+  * @param  HeaderSize Number of words of additional authenticated data
+  * @param  pInput Input data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Output data (aligned on 4 bytes)
+  * @param  pTag Computed tag (4 words)
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef SAES_GCM(SAES_Session_t *pSession, uint32_t Encrypt, const uint32_t *pIV,
+                                  const uint32_t *pHeader, uint32_t HeaderSize, const void *pInput,
+                                  uint32_t Length, void *pOutput, uint32_t *pTag)
+{
+  CRYP_ConfigTypeDef config;
+  uint32_t *p_cbc_iv;
+  uint32_t counter[4];
+  HAL_StatusTypeDef status;
+
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) || (pIV == NULL) || (pTag == NULL) ||
+      (Length == 0U) || ((Length % 16U) != 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  if (HAL_CRYP_GetConfig(&pSession->hcryp, &config) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+  p_cbc_iv = config.pInitVect;
+
+  counter[0] = pIV[0];
+  counter[1] = pIV[1];
+  counter[2] = pIV[2];
+  counter[3] = 2U;
+
+  config.Algorithm = CRYP_AES_GCM_GMAC;
+  config.pInitVect = counter;
+  config.Header = (uint32_t *)pHeader;
+  config.HeaderSize = HeaderSize;
+  config.HeaderWidthUnit = CRYP_HEADERWIDTHUNIT_WORD;
+  status = HAL_CRYP_SetConfig(&pSession->hcryp, &config);
+
+  if (status == HAL_OK)
+  {
+    /* Size is n words */
+    if (Encrypt != 0U)
+    {
+      status = HAL_CRYP_Encrypt(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput,
+                                SAES_SESSION_TIMEOUT);
+    }
+    else
+    {
+      status = HAL_CRYP_Decrypt(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput,
+                                SAES_SESSION_TIMEOUT);
+    }
+  }
+  if (status == HAL_OK)
+  {
+    status = HAL_CRYPEx_AESGCM_GenerateAuthTAG(&pSession->hcryp, pTag, SAES_SESSION_TIMEOUT);
+  }
+
+  /* Back to the CBC configuration of the session */
+  config.Algorithm = CRYP_AES_CBC;
+  config.pInitVect = p_cbc_iv;
+  config.Header = NULL;
+  config.HeaderSize = 0U;
+  if (HAL_CRYP_SetConfig(&pSession->hcryp, &config) != HAL_OK)
+  {
+    status = HAL_ERROR;
+  }
+
+  SecureUtils_Zeroize(counter, sizeof(counter));
+  return status;
+}
+
+/**
+  * @brief  Encrypt and authenticate a buffer with AES-GCM within an open session
+  * @param  pSession Open session
+  * @param  pIV 96-bit IV (3 words), never reused with the same key
+  * @param  pHeader Additional authenticated data (aligned on 4 bytes), may be NULL
+  * @param  HeaderSize Number of words of additional authenticated data
+  * @param  pInput Plain data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Encrypted data (aligned on 4 bytes)
+  * @param  pTag Authentication tag (4 words)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_EncryptGCM(SAES_Session_t *pSession, const uint32_t *pIV, const uint32_t *pHeader,
+                                         uint32_t HeaderSize, const void *pInput, uint32_t Length, void *pOutput,
+                                         uint32_t *pTag)
+{
+  return SAES_GCM(pSession, 1U, pIV, pHeader, HeaderSize, pInput, Length, pOutput, pTag);
+}
+
+/**
+  * @brief  Decrypt a buffer with AES-GCM within an open session
+  * @note   The tag is computed over the same pass as the decryption, the
+  *         caller compares it with the stored one before using the output.
+  * @param  pSession Open session
+  * @param  pIV 96-bit IV (3 words) used for the encryption
+  * @param  pHeader Additional authenticated data (aligned on 4 bytes), may be NULL
+  * @param  HeaderSize Number of words of additional authenticated data
+  * @param  pInput Encrypted data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Plain data (aligned on 4 bytes)
+  * @param  pTag Computed authentication tag (4 words)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_DecryptGCM(SAES_Session_t *pSession, const uint32_t *pIV, const uint32_t *pHeader,
+                                         uint32_t HeaderSize, const void *pInput, uint32_t Length, void *pOutput,
+                                         uint32_t *pTag)
+{
+  return SAES_GCM(pSession, 0U, pIV, pHeader, HeaderSize, pInput, Length, pOutput, pTag);
+}
+
+/**
+  * @brief  Start a DMA encryption within an open session
+  * @note   GPDMA1 moves the data from pInput through SAES to pOutput, the CPU
+  *         is free until SAESSession_PollDMA() reports the end of transfer.
+  *         pInput and pOutput may be the same buffer.
+  * @param  pSession Open session
+  * @param  pInput Plain data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Encrypted data (aligned on 4 bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_EncryptDMA(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) || (Length == 0U) ||
+      ((Length % 16U) != 0U) || (Length > SAES_SESSION_DMA_MAX_SIZE))
+  {
+    return HAL_ERROR;
+  }
+
+  pSession->hcryp.ErrorCode = HAL_CRYP_ERROR_NONE;
+  return HAL_CRYP_Encrypt_DMA(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput);
+}
+
+/**
+  * @brief  Start a DMA decryption within an open session
+  * @note   pInput and pOutput may be the same buffer.
+  * @param  pSession Open session
+  * @param  pInput Encrypted data (aligned on 4 bytes)
+  * @param  Length Number of bytes (multiple of 16 bytes)
+  * @param  pOutput Plain data (aligned on 4 bytes)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_DecryptDMA(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) || (Length == 0U) ||
+      ((Length % 16U) != 0U) || (Length > SAES_SESSION_DMA_MAX_SIZE))
+  {
+    return HAL_ERROR;
+  }
+
+  pSession->hcryp.ErrorCode = HAL_CRYP_ERROR_NONE;
+  return HAL_CRYP_Decrypt_DMA(&pSession->hcryp, (uint32_t *)pInput, (uint16_t)(Length / 4U), (uint32_t *)pOutput);
+}
+
+/**
+  * @brief  Check the progress of a DMA operation
+  * @param  pSession Session running a DMA operation
+  * @retval HAL_BUSY while the transfer runs, HAL_OK once done, HAL_ERROR on DMA or SAES error
+  */
+HAL_StatusTypeDef SAESSession_PollDMA(SAES_Session_t *pSession)
+{
+  if (HAL_CRYP_GetState(&pSession->hcryp) == HAL_CRYP_STATE_BUSY)
+  {
+    return HAL_BUSY;
+  }
+
+  return (pSession->hcryp.ErrorCode == HAL_CRYP_ERROR_NONE) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+  * @brief  Stop a DMA operation that did not complete in time
+  * @note   The output buffer holds partial data, the caller clears it.
+  * @param  pSession Session running a DMA operation
+  * @retval None
+  */
+void SAESSession_AbortDMA(SAES_Session_t *pSession)
+{
+  (void) HAL_DMA_Abort(pSession->hcryp.hdmain);
+  (void) HAL_DMA_Abort(pSession->hcryp.hdmaout);
+  __HAL_CRYP_DISABLE(&pSession->hcryp);
+  pSession->hcryp.State = HAL_CRYP_STATE_READY;
+  __HAL_UNLOCK(&pSession->hcryp);
+}
+
+/**
+  * @brief  Wait for the end of a DMA operation
+  * @param  pSession Session running a DMA operation
+  * @param  Timeout Timeout in ms
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_WaitDMA(SAES_Session_t *pSession, uint32_t Timeout)
+{
+  uint32_t tickstart = HAL_GetTick();
+  HAL_StatusTypeDef status;
+
+  while ((status = SAESSession_PollDMA(pSession)) == HAL_BUSY)
+  {
+    if ((HAL_GetTick() - tickstart) > Timeout)
+    {
+      SAESSession_AbortDMA(pSession);
+      return HAL_TIMEOUT;
+    }
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Hand SAES over to another user between two operations
+  * @note   Nothing is saved : each operation restarts from the session IV
+  *         (CRYP_KEYIVCONFIG_ALWAYS), so there is no state to carry over, and
+  *         the other user may reset the peripheral. An operation in progress
+  *         cannot be suspended.
+  * @param  pSession Open session, with no DMA operation running
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_Suspend(SAES_Session_t *pSession)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_OPEN) ||
+      (HAL_CRYP_GetState(&pSession->hcryp) != HAL_CRYP_STATE_READY))
+  {
+    return HAL_ERROR;
+  }
+
+  pSession->State = SAES_SESSION_SUSPENDED;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Take SAES back once the other user is done
+  * @note   SAES is reset and configured again with the DHUK, as in
+  *         SAESSession_Open().
+  * @param  pSession Suspended session
+  * @retval HAL status
+  */
+HAL_StatusTypeDef SAESSession_Resume(SAES_Session_t *pSession)
+{
+  if ((pSession == NULL) || (pSession->State != SAES_SESSION_SUSPENDED))
+  {
+    return HAL_ERROR;
+  }
+
+  if (SAES_Configure(pSession, pSession->hcryp.Init.pInitVect) != HAL_OK)
+  {
+    return HAL_ERROR;
+  }
+
+  pSession->State = SAES_SESSION_OPEN;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Close a session and zeroize its handle and saved context
+  * @param  pSession Session to close
+  * @retval None
+  */
+void SAESSession_Close(SAES_Session_t *pSession)
+{
+  if (pSession == NULL)
+  {
+    return;
+  }
+
+  if (pSession->State != SAES_SESSION_CLOSED)
+  {
+    (void) HAL_CRYP_DeInit(&pSession->hcryp);
+  }
+  SAES_DMA_Detach(pSession);
+
+  SecureUtils_Zeroize(pSession, sizeof(SAES_Session_t));
+}
+
+/**
+  * @brief  CRYP MSP initialization
+  * @note   The GPDMA1 channels are owned by the session, not by the handle :
+  *         other SAES users (key wrapping) must not reconfigure them.
+  * @param  hcryp CRYP handle
+  * @retval None
+  */
+void HAL_CRYP_MspInit(CRYP_HandleTypeDef *hcryp)
+{
+  if (hcryp->Instance == SAES_S)
+  {
+    __HAL_RCC_SAES_CLK_ENABLE();
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef SAES_SESSION_H
+#define SAES_SESSION_H
+#include "main.h"
+
+#define SAES_SESSION_CLOSED       (0U)
+#define SAES_SESSION_OPEN         (1U)
+#define SAES_SESSION_SUSPENDED    (2U)
+
+/* Largest DMA transfer : the whole HDPL1 OBKeys area */
+#define SAES_SESSION_DMA_MAX_SIZE (0x800U)
+
+/* SAES configured once with the DHUK and reused across operations */
+typedef struct {
+    CRYP_HandleTypeDef hcryp;
+    uint32_t State;         /* SAES_SESSION_xxx, SUSPENDED while another SAES user runs */
+  } SAES_Session_t;
+
+HAL_StatusTypeDef SAESSession_Open(SAES_Session_t *pSession, const uint32_t *pInitVect);
+HAL_StatusTypeDef SAESSession_Encrypt(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput);
+HAL_StatusTypeDef SAESSession_Decrypt(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput);
+HAL_StatusTypeDef SAESSession_EncryptGCM(SAES_Session_t *pSession, const uint32_t *pIV, const uint32_t *pHeader,
+                                         uint32_t HeaderSize, const void *pInput, uint32_t Length, void *pOutput,
+                                         uint32_t *pTag);
+HAL_StatusTypeDef SAESSession_DecryptGCM(SAES_Session_t *pSession, const uint32_t *pIV, const uint32_t *pHeader,
+                                         uint32_t HeaderSize, const void *pInput, uint32_t Length, void *pOutput,
+                                         uint32_t *pTag);
+HAL_StatusTypeDef SAESSession_EncryptDMA(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput);
+HAL_StatusTypeDef SAESSession_DecryptDMA(SAES_Session_t *pSession, const void *pInput, uint32_t Length, void *pOutput);
+HAL_StatusTypeDef SAESSession_PollDMA(SAES_Session_t *pSession);
+HAL_StatusTypeDef SAESSession_WaitDMA(SAES_Session_t *pSession, uint32_t Timeout);
+void SAESSession_AbortDMA(SAES_Session_t *pSession);
+HAL_StatusTypeDef SAESSession_Suspend(SAES_Session_t *pSession);
+HAL_StatusTypeDef SAESSession_Resume(SAES_Session_t *pSession);
+void SAESSession_Close(SAES_Session_t *pSession);
+
+/* GPDMA1 channels feeding and draining SAES, serviced from stm32h5xx_it.c */
+extern DMA_HandleTypeDef hdma_saes_in;
+extern DMA_HandleTypeDef hdma_saes_out;
+
+#endif
@@ -0,0 +1,17 @@
+#include "secure_utils.h"
+
+/**
+  * @brief  Clear a memory area in a way the compiler cannot optimize away
+  * @param  pData Area to clear
+  * @param  Length Number of bytes
+  * @retval None
+  */
+void SecureUtils_Zeroize(void *pData, uint32_t Length)
+{
+  volatile uint8_t *p = (volatile uint8_t *)pData;
+
+  while (Length-- != 0U)
+  {
+    *p++ = 0U;
+  }
+}
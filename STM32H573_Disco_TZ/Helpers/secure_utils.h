@@ -0,0 +1,10 @@
+#ifndef SECURE_UTILS_H
+#define SECURE_UTILS_H
+#include "main.h"
+
+/* EPOCH_SEL value selecting the secure epoch for the DHUK derivation */
+#define SBS_EXT_EPOCHSELCR_EPOCH_SEL_S_EPOCH    (1U << SBS_EPOCHSELCR_EPOCH_SEL_Pos)
+
+void SecureUtils_Zeroize(void *pData, uint32_t Length);
+
+#endif
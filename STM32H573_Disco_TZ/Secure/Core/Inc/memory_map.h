@@ -0,0 +1,50 @@
+/* Generated by Tools/gen_memory_map.py from the secure and non secure
+ * linker scripts. Do not edit, regenerate after changing a MEMORY region. */
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#define MEMORY_MAP_FLASH_SECTOR_SIZE (0x00002000U)   /* Watermark granularity */
+#define MEMORY_MAP_S_FLASH_START     (0x0C000000U)
+#define MEMORY_MAP_S_FLASH_SIZE      (0x0003E000U)
+#define MEMORY_MAP_S_NSC_START       (0x0C03E000U)
+#define MEMORY_MAP_S_NSC_SIZE        (0x00002000U)
+#define MEMORY_MAP_S_RAM_START       (0x30000000U)
+#define MEMORY_MAP_S_RAM_SIZE        (0x00050000U)
+#define MEMORY_MAP_NS_FLASH_START    (0x08100000U)
+#define MEMORY_MAP_NS_FLASH_SIZE     (0x00100000U)
+#define MEMORY_MAP_NS_RAM_START      (0x20050000U)
+#define MEMORY_MAP_NS_RAM_SIZE       (0x00050000U)
+#define MEMORY_MAP_NS_VTOR           (0x08100000U)   /* Non secure vector table, first word of its FLASH region */
+#define MEMORY_MAP_WM1_START         (0x00000000U)   /* Bank1 secure sectors */
+#define MEMORY_MAP_WM1_END           (0x0000001FU)
+#define MEMORY_MAP_WM2_START         (0x0000007FU)   /* Bank2 fully non secure */
+#define MEMORY_MAP_WM2_END           (0x00000000U)
+#define MEMORY_MAP_NS_SPARE_START    (0x08040000U)   /* Bank1 flash left to the non secure side, its SPARE region */
+#define MEMORY_MAP_NS_SPARE_SIZE     (0x000BC000U)
+#define MEMORY_MAP_S_DATA_START      (0x0C0FC000U)   /* Bank1 secure data sectors, flash_partition.c */
+#define MEMORY_MAP_S_DATA_SIZE       (0x00004000U)
+
+#define MEMORY_MAP_S_OFFSET(a)        ((a) - 0x0C000000U)
+#define MEMORY_MAP_NS_OFFSET(a)       ((a) - 0x08000000U)
+
+_Static_assert((MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_FLASH_START) % MEMORY_MAP_FLASH_SECTOR_SIZE) == 0U,
+               "Secure flash must start on a sector");
+_Static_assert(MEMORY_MAP_S_NSC_START == (MEMORY_MAP_S_FLASH_START + MEMORY_MAP_S_FLASH_SIZE),
+               "NSC veneers must follow the secure flash, inside the watermark");
+_Static_assert(((MEMORY_MAP_WM1_END + 1U) * MEMORY_MAP_FLASH_SECTOR_SIZE) ==
+               MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_NSC_START + MEMORY_MAP_S_NSC_SIZE),
+               "Secure flash and NSC must end on a sector");
+_Static_assert(MEMORY_MAP_WM1_END < (0x00100000U / MEMORY_MAP_FLASH_SECTOR_SIZE),
+               "Secure image must fit in bank1");
+_Static_assert(MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_FLASH_START) >= ((MEMORY_MAP_WM1_END + 1U) * MEMORY_MAP_FLASH_SECTOR_SIZE),
+               "Non secure flash overlaps the secure watermark");
+_Static_assert(MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_SPARE_START + MEMORY_MAP_NS_SPARE_SIZE) ==
+               MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_DATA_START),
+               "Secure data sectors must follow the non secure spare flash");
+_Static_assert((MEMORY_MAP_NS_VTOR & 0x3FFU) == 0U,
+               "Non secure vector table must be aligned on its size");
+_Static_assert(((MEMORY_MAP_NS_RAM_START & 0x0FFFFFFFU) >= ((MEMORY_MAP_S_RAM_START & 0x0FFFFFFFU) + MEMORY_MAP_S_RAM_SIZE)) ||
+               (((MEMORY_MAP_NS_RAM_START & 0x0FFFFFFFU) + MEMORY_MAP_NS_RAM_SIZE) <= (MEMORY_MAP_S_RAM_START & 0x0FFFFFFFU)),
+               "Secure and non secure RAM overlap");
+
+#endif
@@ -57,7 +57,11 @@ void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
 /* USER CODE BEGIN EFP */
-
+void GPDMA1_Channel5_IRQHandler(void);
+void GPDMA1_Channel6_IRQHandler(void);
+void GPDMA1_Channel7_IRQHandler(void);
+void FLASH_S_IRQHandler(void);
+void RNG_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -35,12 +35,18 @@ extern "C" {
 extern UART_HandleTypeDef huart1;
 
 /* USER CODE BEGIN Private defines */
+/* Bytes kept while the flash jobs run, see FlashJob_IdleCallback() */
+#define CONSOLE_RX_SIZE           (64U)
+/* Period of the keep-alive byte sent while the flash jobs run */
+#define CONSOLE_KEEPALIVE_MS      (500U)
 
 /* USER CODE END Private defines */
 
 void MX_USART1_UART_Init(void);
 
 /* USER CODE BEGIN Prototypes */
+HAL_StatusTypeDef Console_Receive(void *pData, uint32_t Length, uint32_t Timeout);
+void Console_SetKeepAlive(uint8_t Code);
 
 /* USER CODE END Prototypes */
 
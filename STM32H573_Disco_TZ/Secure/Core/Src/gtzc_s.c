@@ -35,6 +35,11 @@ void MX_GTZC_S_Init(void)
   MPCBB_ConfigTypeDef MPCBB_Area_Desc = {0};
 
   /* USER CODE BEGIN GTZC_S_Init 1 */
+  /* AES receives OEM keys shared by SAES (Helpers/oem_key.c) */
+  if (HAL_GTZC_TZSC_ConfigPeriphAttributes(GTZC_PERIPH_AES, GTZC_TZSC_PERIPH_SEC|GTZC_TZSC_PERIPH_PRIV) != HAL_OK)
+  {
+    Error_Handler();
+  }
 
   /* USER CODE END GTZC_S_Init 1 */
   if (HAL_GTZC_TZSC_ConfigPeriphAttributes(GTZC_PERIPH_HASH, GTZC_TZSC_PERIPH_SEC|GTZC_TZSC_PERIPH_PRIV) != HAL_OK)
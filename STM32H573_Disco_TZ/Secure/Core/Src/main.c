@@ -30,6 +30,16 @@
 #include "product_state.h"
 #include "obk_provisioning.h"
 #include "ob_trustzone.h"
+#include "ob_config.h"
+#include "auto_provisioning.h"
+#include "boot_policy.h"
+#include "memory_map.h"
+#include "flash_partition.h"
+#include "obk_stream.h"
+#include "obk_directory.h"
+#include "key_store.h"
+#include "oem_key.h"
+#include "entropy_pool.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -45,9 +55,8 @@
 /* USER CODE BEGIN VTOR_TABLE */
 
 /* Non-secure Vector table to jump to (internal Flash Bank2 here)             */
-/* Caution: address must correspond to non-secure internal Flash where is     */
-/*          mapped in the non-secure vector table                             */
-#define VTOR_TABLE_NS_START_ADDR  0x08100000UL
+/* Derived from the FLASH region of the non-secure linker script             */
+#define VTOR_TABLE_NS_START_ADDR  MEMORY_MAP_NS_VTOR
 
 /* USER CODE END VTOR_TABLE*/
 
@@ -80,11 +89,20 @@ void PrintMenu(void)
 	printf("   3) Set PRODUCT_STATE to CLOSED (will reset) .. 3\r\n");
 	printf("   4) Provision DA credentials in OBK ........... 4\r\n");
 	printf("\r\n");
+	printf("Apply option bytes 1 to 3 (resets) ... o\r\n");
+	printf("Set PRODUCT_STATE to TZ-CLOSED ....... z\r\n");
+	printf("Receive .obk files over UART ......... u\r\n");
+	printf("Rotate DA credentials (newer config) . r\r\n");
 	printf("Read provisioned data in OBK.......... p\r\n");
+	printf("Compare full/bounded OBK swap time ... t\r\n");
+	printf("Provision keys (Keys_Config.h) ....... K\r\n");
+	printf("Key store statistics and flush ....... k\r\n");
+	printf("Entropy pool statistics .............. e\r\n");
 	printf("Display PRODUCT_STATE value........... s\r\n");
 	printf("Continue to non secure app ........... c\t\n");
 	printf("\r\n");
 	printf("Regression ........................... R\r\n");
+	printf("Non secure regression (TZ-CLOSED) .... N\r\n");
 }
 
 void ProvisioningMenu(void)
@@ -93,7 +111,7 @@ void ProvisioningMenu(void)
 	while (1)
 	{
 		uint8_t choice;
-		HAL_StatusTypeDef status = HAL_UART_Receive(&huart1, &choice, 1, 1000);
+		HAL_StatusTypeDef status = Console_Receive(&choice, 1, 1000);
 
 		if (status == HAL_OK)
 		{
@@ -111,19 +129,59 @@ void ProvisioningMenu(void)
 				printf("====== CLOSE the product ...\r\n");
 				ProductState_Close();
 				break;
+			case 'z':
+				printf("====== TZ-CLOSE the product ...\r\n");
+				ProductState_Goto(OB_PROD_STATE_TZ_CLOSED);
+				break;
+			case 'o':
+				printf("====== Apply option byte configuration ...\r\n");
+				OBConfig_Apply(OB_CONFIG_FIELD_ALL);
+				break;
 			case '4':
 				printf("====== Provision the DA credentials ...\r\n");
 				OBKProvisioning_ProvisionDA();
 				break;
+			case 'r':
+				printf("====== Rotate the DA credentials ...\r\n");
+				OBKProvisioning_RotateDA();
+				break;
+			case 'u':
+				printf("====== Receive .obk files ...\r\n");
+				OBKStream_Receive();
+				break;
 
 			case 'p':
 				printf("====== Read provisioned content ...\r\n");
 				OBKProvisioning_ReadDA();
 				break;
+			case 't':
+				printf("====== OBK swap timing ...\r\n");
+				OBKDirectory_SwapBenchmark();
+				break;
+			case 'K':
+				printf("====== Provision the keys ...\r\n");
+				if (OemKey_ProvisionConfig(0U) != PROV_OK)
+				{
+					printf("OEM key provisioning failed\r\n");
+				}
+				if (KeyStore_ProvisionConfig() != PROV_OK)
+				{
+					printf("Key store provisioning failed\r\n");
+				}
+				break;
+			case 'k':
+				printf("====== Key store statistics ...\r\n");
+				KeyStore_PrintStats();
+				KeyStore_Flush();
+				break;
+			case 'e':
+				printf("====== Entropy pool statistics ...\r\n");
+				EntropyPool_PrintStats();
+				break;
 			case 's':
 				printf("====== Read Product state ...\r\n");
 				uint32_t prodState=ProductState_Get();
-				printf("PRODUCT_STATE value : 0x%2.2lx\r\n", prodState);
+				printf("PRODUCT_STATE value : 0x%2.2lx (%s)\r\n", prodState, ProductState_Name(prodState << FLASH_OPTSR_PRODUCT_STATE_Pos));
 				break;
 			case 'c':
 				printf("====== Continue and jump to non secure app .....\r\n");
@@ -133,6 +191,10 @@ void ProvisioningMenu(void)
 				printf("====== Regression ...\r\n");
 				ProductState_Regression();
 				break;
+			case 'N':
+				printf("====== Non secure regression ...\r\n");
+				ProductState_NSRegression();
+				break;
 			default:
 				break;
 			}
@@ -177,21 +239,39 @@ int main(void)
   MX_ICACHE_Init();
   MX_RNG_Init();
   /* USER CODE BEGIN 2 */
+  EntropyPool_Init();
   MX_USART1_UART_Init();
-  printf("=======================================\r\n");
-  printf("S: H573 Provisioning Example Starting  \r\n");
 
 // When AUTO is defined, the device is setup automatically with option byte configuration,
 // switched to close state and provisioned with Debug Authentication credentials
+// The sequence resumes after each reset from a journal in a TAMP backup register
+// and goes on to the non secure app. The menu is only shown if it fails.
 // This can be enabled once each step was tested interactively.
 //#define AUTO
+
+  // Block-based flash attributes are volatile, set before any non secure code runs
+  if (FlashPartition_Apply() != PROV_OK)
+  {
+    printf("Flash partition table not applied\r\n");
+  }
+
+  // Fully provisioned and unchanged since last boot : straight to the non secure app
+  if (BootPolicy_FastPath() == 0U)
+  {
+    printf("=======================================\r\n");
+    printf("S: H573 Provisioning Example Starting  \r\n");
 #ifdef AUTO
-  FlashOBConfig_CheckAndSetTrustZone();
-  FlashOBConfig_CheckAndSetSecureWatermark();
-  FlashOBConfig_CloseDevice();
-  Provisioning_ProvisionDA();
+    if (AutoProvisioning_Run() != PROV_OK)
+    {
+      ProvisioningMenu();
+    }
+#else
+    ProvisioningMenu();
 #endif
-  ProvisioningMenu();
+
+    // Recorded at first completion, skipped while not fully provisioned
+    (void) BootPolicy_Record();
+  }
 
   /* USER CODE END 2 */
 
@@ -22,6 +22,9 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "secure_nsc.h"
+#include "key_store.h"
+#include "entropy_pool.h"
+#include <arm_cmse.h>
 /** @addtogroup STM32H5xx_HAL_Examples
 
   * @{
@@ -67,6 +70,80 @@ CMSE_NS_ENTRY void SECURE_RegisterCallback(SECURE_CallbackIDTypeDef CallbackId,
   }
 }
 
+/**
+  * @brief  Copy a key store entry flagged KEY_STORE_ID_NS to non-secure memory
+  * @note   Keys are served from the secure key store cache, only the first
+  *         lookup after a flush reads and decrypts the OBK record.
+  * @param  Id      key ID
+  * @param  pKey    non-secure destination buffer
+  * @param  Size    size of the destination buffer
+  * @param  pLength non-secure variable set to the key length
+  * @retval 0 if OK, -1 for a buffer outside non-secure memory, key store error otherwise
+  */
+CMSE_NS_ENTRY int32_t SECURE_KeyStoreGet(uint16_t Id, void *pKey, uint32_t Size, uint32_t *pLength)
+{
+  if ((cmse_check_address_range(pKey, Size, CMSE_NONSECURE | CMSE_MPU_READWRITE) == NULL) ||
+      (cmse_check_address_range(pLength, sizeof(uint32_t), CMSE_NONSECURE | CMSE_MPU_READWRITE) == NULL))
+  {
+    return -1;
+  }
+
+  return KeyStore_Export(Id, pKey, Size, pLength);
+}
+
+/**
+  * @brief  Zeroize the keys cached by the secure key store
+  * @retval None
+  */
+CMSE_NS_ENTRY void SECURE_KeyStoreFlush(void)
+{
+  KeyStore_Flush();
+}
+
+/**
+  * @brief  Get the secure key store counters
+  * @param  pStats non-secure structure to be filled
+  * @retval None
+  */
+CMSE_NS_ENTRY void SECURE_KeyStoreGetStats(SECURE_KeyStoreStatsTypeDef *pStats)
+{
+  KeyStore_Stats_t stats;
+
+  if (cmse_check_address_range(pStats, sizeof(SECURE_KeyStoreStatsTypeDef),
+                               CMSE_NONSECURE | CMSE_MPU_READWRITE) == NULL)
+  {
+    return;
+  }
+
+  KeyStore_GetStats(&stats);
+  pStats->Hits = stats.Hits;
+  pStats->Misses = stats.Misses;
+  pStats->Evictions = stats.Evictions;
+  pStats->Flushes = stats.Flushes;
+  pStats->LastHitUs = stats.LastHitUs;
+  pStats->LastMissUs = stats.LastMissUs;
+}
+
+/**
+  * @brief  Get random bytes from the secure entropy pool
+  * @note   The bytes are taken from the pool refilled in the background, the
+  *         call does not wait for the RNG.
+  * @param  pData  non-secure destination buffer
+  * @param  Length number of bytes, up to ENTROPY_POOL_SIZE
+  * @retval 0 (PROV_OK) if OK, -1 for a buffer outside non-secure memory,
+  *         PROV_ERR_STATE if the pool does not hold Length bytes yet,
+  *         Prov_Status_t error otherwise
+  */
+CMSE_NS_ENTRY int32_t SECURE_EntropyPoolGet(void *pData, uint32_t Length)
+{
+  if (cmse_check_address_range(pData, Length, CMSE_NONSECURE | CMSE_MPU_READWRITE) == NULL)
+  {
+    return -1;
+  }
+
+  return EntropyPool_Get(pData, Length);
+}
+
 /**
   * @}
   */
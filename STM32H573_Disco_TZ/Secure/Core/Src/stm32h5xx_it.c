@@ -22,6 +22,12 @@
 #include "stm32h5xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "obk_provisioning.h"
+#include "saes_session.h"
+#include "hash_engine.h"
+#include "flash_job.h"
+#include "key_store.h"
+#include "rng.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -69,7 +75,12 @@
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
-
+  /* Double ECC error during an OBK read : reported by the reader */
+  HAL_FLASHEx_ECCD_IRQHandler();
+  if (OBKProvisioning_DoubleECC_Taken() != 0U)
+  {
+    return;
+  }
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
    while (1)
@@ -195,13 +206,18 @@ void PendSV_Handler(void)
 /**
   * @brief This function handles System tick timer.
   */
-void SysTick_Handler(void)
+FLASH_JOB_RAMFUNC void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
 
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  /* The key store runs from flash, its idle flush waits for the flash jobs */
+  if (FlashJob_IsBusy() == 0U)
+  {
+    KeyStore_IdleCallback();
+  }
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -214,5 +230,43 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles GPDMA1 Channel 5 global interrupt (HASH_IN).
+  */
+void GPDMA1_Channel5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_hash_in);
+}
+
+/**
+  * @brief This function handles GPDMA1 Channel 6 global interrupt (SAES_IN).
+  */
+void GPDMA1_Channel6_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_saes_in);
+}
 
+/**
+  * @brief This function handles GPDMA1 Channel 7 global interrupt (SAES_OUT).
+  */
+void GPDMA1_Channel7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_saes_out);
+}
+
+/**
+  * @brief This function handles FLASH secure global interrupt (flash jobs).
+  */
+FLASH_JOB_RAMFUNC void FLASH_S_IRQHandler(void)
+{
+  HAL_FLASH_IRQHandler();
+}
+
+/**
+  * @brief This function handles RNG global interrupt (entropy pool refill).
+  */
+void RNG_IRQHandler(void)
+{
+  HAL_RNG_IRQHandler(&hrng);
+}
 /* USER CODE END 1 */
@@ -21,6 +21,16 @@
 #include "usart.h"
 
 /* USER CODE BEGIN 0 */
+#include "flash_job.h"
+
+/* Received by FlashJob_IdleCallback(), read by Console_Receive() */
+static uint8_t Console_Rx[CONSOLE_RX_SIZE];
+static uint32_t Console_RxHead = 0U;
+static uint32_t Console_RxTail = 0U;
+
+/* Keep-alive byte, 0 when disabled */
+static uint8_t Console_KeepAlive = 0U;
+static uint32_t Console_KeepAliveTick = 0U;
 
 /* USER CODE END 0 */
 
@@ -136,10 +146,78 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
 }
 
 /* USER CODE BEGIN 1 */
-int _write(int file, char *ptr, int len)
+/* Console output from SRAM, HAL_UART_Transmit() is linked there too */
+FLASH_JOB_RAMFUNC int _write(int file, char *ptr, int len)
 {
 	HAL_UART_Transmit(&huart1, (uint8_t *)ptr, len, 1000);
 	return len;
 }
 
+/**
+  * @brief  Service USART1 while FlashJob_Wait() waits for the flash
+  * @note   The receive FIFO is disabled : a byte typed in the menu or sent by
+  *         a host during a write would overrun within one character time, so
+  *         the register is polled instead of waiting for an interrupt. The
+  *         keep-alive byte tells a host waiting for an answer that the device
+  *         is busy and not stuck.
+  * @retval None
+  */
+FLASH_JOB_RAMFUNC void FlashJob_IdleCallback(void)
+{
+	if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE) != 0U)
+	{
+		uint8_t data = (uint8_t)READ_REG(huart1.Instance->RDR);
+
+		if ((Console_RxHead - Console_RxTail) < CONSOLE_RX_SIZE)
+		{
+			Console_Rx[Console_RxHead % CONSOLE_RX_SIZE] = data;
+			Console_RxHead++;
+		}
+	}
+
+	if ((Console_KeepAlive != 0U) && ((HAL_GetTick() - Console_KeepAliveTick) >= CONSOLE_KEEPALIVE_MS) &&
+	    (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_TXE) != 0U))
+	{
+		WRITE_REG(huart1.Instance->TDR, Console_KeepAlive);
+		Console_KeepAliveTick = HAL_GetTick();
+	}
+}
+
+/**
+  * @brief  Receive console bytes, the ones kept during a flash wait first
+  * @param  pData Destination buffer
+  * @param  Length Number of bytes
+  * @param  Timeout Timeout in ms for the bytes still to be received
+  * @retval HAL status
+  */
+HAL_StatusTypeDef Console_Receive(void *pData, uint32_t Length, uint32_t Timeout)
+{
+	uint8_t *pByte = (uint8_t *)pData;
+	uint32_t i = 0U;
+
+	while ((i < Length) && (Console_RxTail != Console_RxHead))
+	{
+		pByte[i] = Console_Rx[Console_RxTail % CONSOLE_RX_SIZE];
+		Console_RxTail++;
+		i++;
+	}
+
+	if (i == Length)
+	{
+		return HAL_OK;
+	}
+	return HAL_UART_Receive(&huart1, &pByte[i], (uint16_t)(Length - i), Timeout);
+}
+
+/**
+  * @brief  Send a keep-alive byte while the flash jobs run
+  * @param  Code Byte sent every CONSOLE_KEEPALIVE_MS, 0 to stop
+  * @retval None
+  */
+void Console_SetKeepAlive(uint8_t Code)
+{
+	Console_KeepAliveTick = HAL_GetTick();
+	Console_KeepAlive = Code;
+}
+
 /* USER CODE END 1 */
@@ -36,10 +36,27 @@ typedef enum
   GTZC_ERROR_CB_ID       = 0x01U  /*!< GTZC secure error callback ID */
 } SECURE_CallbackIDTypeDef;
 
+/**
+  * @brief  secure key store counters
+  */
+typedef struct
+{
+  uint32_t Hits;                  /*!< Lookups served from the cache */
+  uint32_t Misses;                /*!< Lookups that read and decrypted the OBK record */
+  uint32_t Evictions;             /*!< Least recently used keys dropped */
+  uint32_t Flushes;               /*!< Explicit and idle zeroizations */
+  uint32_t LastHitUs;             /*!< Duration of the last hit in microseconds */
+  uint32_t LastMissUs;            /*!< Duration of the last miss in microseconds */
+} SECURE_KeyStoreStatsTypeDef;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 void SECURE_RegisterCallback(SECURE_CallbackIDTypeDef CallbackId, void *func);
+int32_t SECURE_KeyStoreGet(uint16_t Id, void *pKey, uint32_t Size, uint32_t *pLength);
+void SECURE_KeyStoreFlush(void);
+void SECURE_KeyStoreGetStats(SECURE_KeyStoreStatsTypeDef *pStats);
+int32_t SECURE_EntropyPoolGet(void *pData, uint32_t Length);
 
 #endif /* SECURE_NSC_H */
 /* USER CODE END Non_Secure_CallLib_h */
@@ -0,0 +1,148 @@
+"""Derive the TrustZone memory map from the linker scripts.
+
+Reads the MEMORY regions of the secure and non secure linker scripts and
+writes Secure/Core/Inc/memory_map.h : secure watermark sectors, the bank 1
+flash left to the non secure SPARE region and the non secure vector table
+address, with static asserts checking them.
+Run it after changing a MEMORY region:
+
+    python3 gen_memory_map.py            regenerate memory_map.h
+    python3 gen_memory_map.py --check    fail if memory_map.h is out of date
+"""
+import argparse
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "STM32H573_Disco_TZ")
+SECURE_LD = os.path.join(ROOT, "Secure", "STM32H573IIKXQ_FLASH.ld")
+NONSECURE_LD = os.path.join(ROOT, "NonSecure", "STM32H573IIKXQ_FLASH.ld")
+OUTPUT = os.path.join(ROOT, "Secure", "Core", "Inc", "memory_map.h")
+
+FLASH_BASE_NS = 0x08000000
+FLASH_BASE_S = 0x0C000000
+FLASH_BANK_SIZE = 0x100000
+FLASH_SECTOR_SIZE = 0x2000
+
+# Last bank 1 sectors made secure by the Helpers/flash_partition.c table,
+# taken out of the spare flash left to the non secure side
+S_DATA_SECTORS = 2
+
+REGION = re.compile(r"^\s*(\w+)\s*\([^)]*\)\s*:\s*ORIGIN\s*=\s*(\w+)\s*,\s*LENGTH\s*=\s*(\w+)", re.M)
+
+
+def size(text):
+    units = {"K": 1024, "M": 1024 * 1024}
+    if text[-1].upper() in units:
+        return int(text[:-1], 0) * units[text[-1].upper()]
+    return int(text, 0)
+
+
+def regions(path):
+    with open(path) as f:
+        memory = re.search(r"MEMORY\s*\{(.*?)\}", f.read(), re.S).group(1)
+    return {name: (int(origin, 0), size(length)) for name, origin, length in REGION.findall(memory)}
+
+
+def generate():
+    secure = regions(SECURE_LD)
+    nonsecure = regions(NONSECURE_LD)
+    s_flash, s_nsc, s_ram = secure["FLASH"], secure["FLASH_NSC"], secure["RAM"]
+    ns_flash, ns_ram = nonsecure["FLASH"], nonsecure["RAM"]
+
+    # Bank 1 watermark covers the secure image and its NSC veneers
+    s_end = max(s_flash[0] + s_flash[1], s_nsc[0] + s_nsc[1]) - FLASH_BASE_S
+    wm1_start = (s_flash[0] - FLASH_BASE_S) // FLASH_SECTOR_SIZE
+    wm1_end = (s_end - 1) // FLASH_SECTOR_SIZE
+    spare = FLASH_BASE_NS + (wm1_end + 1) * FLASH_SECTOR_SIZE
+    s_data = FLASH_BANK_SIZE - S_DATA_SECTORS * FLASH_SECTOR_SIZE
+
+    # The non secure SPARE region must be exactly the bank 1 flash left free
+    if nonsecure.get("SPARE") != (spare, FLASH_BASE_NS + s_data - spare):
+        sys.exit(f"NonSecure SPARE region must be ORIGIN = 0x{spare:08X}, "
+                 f"LENGTH = {(FLASH_BASE_NS + s_data - spare) // 1024}K")
+
+    defines = [
+        ("FLASH_SECTOR_SIZE", FLASH_SECTOR_SIZE, "Watermark granularity"),
+        ("S_FLASH_START", s_flash[0], None),
+        ("S_FLASH_SIZE", s_flash[1], None),
+        ("S_NSC_START", s_nsc[0], None),
+        ("S_NSC_SIZE", s_nsc[1], None),
+        ("S_RAM_START", s_ram[0], None),
+        ("S_RAM_SIZE", s_ram[1], None),
+        ("NS_FLASH_START", ns_flash[0], None),
+        ("NS_FLASH_SIZE", ns_flash[1], None),
+        ("NS_RAM_START", ns_ram[0], None),
+        ("NS_RAM_SIZE", ns_ram[1], None),
+        ("NS_VTOR", ns_flash[0], "Non secure vector table, first word of its FLASH region"),
+        ("WM1_START", wm1_start, "Bank1 secure sectors"),
+        ("WM1_END", wm1_end, None),
+        ("WM2_START", 0x7F, "Bank2 fully non secure"),
+        ("WM2_END", 0x00, None),
+        ("NS_SPARE_START", spare, "Bank1 flash left to the non secure side, its SPARE region"),
+        ("NS_SPARE_SIZE", FLASH_BASE_NS + s_data - spare, None),
+        ("S_DATA_START", FLASH_BASE_S + s_data, "Bank1 secure data sectors, flash_partition.c"),
+        ("S_DATA_SIZE", S_DATA_SECTORS * FLASH_SECTOR_SIZE, None),
+    ]
+
+    lines = [
+        "/* Generated by Tools/gen_memory_map.py from the secure and non secure",
+        " * linker scripts. Do not edit, regenerate after changing a MEMORY region. */",
+        "#ifndef MEMORY_MAP_H",
+        "#define MEMORY_MAP_H",
+        "",
+    ]
+    for name, value, comment in defines:
+        line = f"#define MEMORY_MAP_{name:<18}(0x{value:08X}U)"
+        lines.append(line + (f"   /* {comment} */" if comment else ""))
+    lines += [
+        "",
+        "#define MEMORY_MAP_S_OFFSET(a)        ((a) - 0x0C000000U)",
+        "#define MEMORY_MAP_NS_OFFSET(a)       ((a) - 0x08000000U)",
+        "",
+        "_Static_assert((MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_FLASH_START) % MEMORY_MAP_FLASH_SECTOR_SIZE) == 0U,",
+        "               \"Secure flash must start on a sector\");",
+        "_Static_assert(MEMORY_MAP_S_NSC_START == (MEMORY_MAP_S_FLASH_START + MEMORY_MAP_S_FLASH_SIZE),",
+        "               \"NSC veneers must follow the secure flash, inside the watermark\");",
+        "_Static_assert(((MEMORY_MAP_WM1_END + 1U) * MEMORY_MAP_FLASH_SECTOR_SIZE) ==",
+        "               MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_NSC_START + MEMORY_MAP_S_NSC_SIZE),",
+        "               \"Secure flash and NSC must end on a sector\");",
+        "_Static_assert(MEMORY_MAP_WM1_END < (0x00100000U / MEMORY_MAP_FLASH_SECTOR_SIZE),",
+        "               \"Secure image must fit in bank1\");",
+        "_Static_assert(MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_FLASH_START) >= ((MEMORY_MAP_WM1_END + 1U) * MEMORY_MAP_FLASH_SECTOR_SIZE),",
+        "               \"Non secure flash overlaps the secure watermark\");",
+        "_Static_assert(MEMORY_MAP_NS_OFFSET(MEMORY_MAP_NS_SPARE_START + MEMORY_MAP_NS_SPARE_SIZE) ==",
+        "               MEMORY_MAP_S_OFFSET(MEMORY_MAP_S_DATA_START),",
+        "               \"Secure data sectors must follow the non secure spare flash\");",
+        "_Static_assert((MEMORY_MAP_NS_VTOR & 0x3FFU) == 0U,",
+        "               \"Non secure vector table must be aligned on its size\");",
+        "_Static_assert(((MEMORY_MAP_NS_RAM_START & 0x0FFFFFFFU) >= ((MEMORY_MAP_S_RAM_START & 0x0FFFFFFFU) + MEMORY_MAP_S_RAM_SIZE)) ||",
+        "               (((MEMORY_MAP_NS_RAM_START & 0x0FFFFFFFU) + MEMORY_MAP_NS_RAM_SIZE) <= (MEMORY_MAP_S_RAM_START & 0x0FFFFFFFU)),",
+        "               \"Secure and non secure RAM overlap\");",
+        "",
+        "#endif",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--check", action="store_true", help="only check that memory_map.h is up to date")
+    args = parser.parse_args()
+
+    header = generate()
+    if args.check:
+        with open(OUTPUT) as f:
+            if f.read() != header:
+                print(f"{OUTPUT} is out of date, run gen_memory_map.py")
+                sys.exit(1)
+        print("memory_map.h up to date")
+        return
+    with open(OUTPUT, "w") as f:
+        f.write(header)
+    print(f"{OUTPUT} written")
+
+
+if __name__ == "__main__":
+    main()
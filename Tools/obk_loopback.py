@@ -0,0 +1,144 @@
+"""Host stand-in for the secure firmware .obk receive path (OBKStream_Receive).
+
+Opens a pseudo terminal and answers the OBKS protocol exactly like the
+device does, so obk_send.py can be exercised and timed on Linux without a
+board. Records accepted by the stand-in are kept in memory, so a second
+session provisioning the same slot is refused like on a real device.
+
+    python3 obk_loopback.py [--baud 115200]
+"""
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import time
+import tty
+
+OBK_STREAM_MAGIC = 0x534B424F
+OBK_STREAM_ACK = 0x06
+OBK_STREAM_NACK = 0x15
+OBK_STREAM_BUSY = 0x16
+OBK_STREAM_MAX_FILES = 16
+OBK_STREAM_CHUNK = 0x10
+
+FLASH_OBK_BASE_S = 0x0FFD0000
+FLASH_OBK_BASE_DA = FLASH_OBK_BASE_S + 0x100
+OBK_HDPL1_END = 0x8FF
+OBK_HDPL1_SIZE = 0x800
+OBK_SHA256_LENGTH = 32
+OBK_MAX_RECORD_SIZE = 0x60
+OBK_DIR_OFFSET = 0x100 + OBK_MAX_RECORD_SIZE
+OBK_DIR_SIZE = 0x90
+
+
+def check_header(addr, length, encrypted, provisioned):
+    """Same rules as OBKProvisioning_CheckHeader()."""
+    offset = addr - FLASH_OBK_BASE_S
+    if (addr < FLASH_OBK_BASE_DA or offset > OBK_HDPL1_END
+            or (offset < OBK_DIR_OFFSET + OBK_DIR_SIZE and offset + length > OBK_DIR_OFFSET)):
+        return "Wrong address (0x%x)" % addr
+    if addr in provisioned:
+        return "Already provisioned (0x%x) !" % addr
+    if encrypted != 1:
+        return "Wrong Header encrypted value (0x%x)" % encrypted
+    if (length <= OBK_SHA256_LENGTH or offset % 16 or length % 16
+            or offset + length - 1 > OBK_HDPL1_END
+            or (addr == FLASH_OBK_BASE_DA and length != OBK_MAX_RECORD_SIZE)):
+        return "Wrong size (0x%x)" % length
+    return None
+
+
+class Device:
+    def __init__(self, fd, baud=0):
+        self.fd = fd
+        self.byte_time = 10.0 / baud if baud else 0.0
+        self.provisioned = {}
+
+    def read(self, length):
+        data = b""
+        while len(data) < length:
+            chunk = os.read(self.fd, length - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        if self.byte_time:
+            time.sleep(length * self.byte_time)
+        return data
+
+    def reply(self, code, trace=None):
+        if trace:
+            os.write(self.fd, (trace + "\r\n").encode())
+        os.write(self.fd, bytes([code]))
+
+    def session(self):
+        magic, nb_files = struct.unpack("<II", self.read(8))
+        if magic != OBK_STREAM_MAGIC or nb_files == 0 or nb_files > OBK_STREAM_MAX_FILES:
+            self.reply(OBK_STREAM_NACK)
+            return False
+        self.reply(OBK_STREAM_ACK)
+
+        records = {}
+        used = 0
+        for _ in range(nb_files):
+            addr, length, encrypted = struct.unpack("<III", self.read(12))
+            error = check_header(addr, length, encrypted, self.provisioned)
+            if error is None and used + length > OBK_HDPL1_SIZE:
+                error = "Staging buffer full"
+            if error is not None:
+                self.reply(OBK_STREAM_NACK, error)
+                return False
+            self.reply(OBK_STREAM_ACK)
+
+            expected = self.read(OBK_SHA256_LENGTH)
+            digest = hashlib.sha256()
+            payload = expected
+            for _ in range(OBK_SHA256_LENGTH, length, OBK_STREAM_CHUNK):
+                chunk = self.read(OBK_STREAM_CHUNK)
+                digest.update(chunk)
+                payload += chunk
+            if digest.digest() != expected:
+                self.reply(OBK_STREAM_NACK)
+                return False
+            self.reply(OBK_STREAM_ACK)
+            records[addr] = payload
+            used += length
+
+        # Sent by the device while it writes the OBK
+        os.write(self.fd, bytes([OBK_STREAM_BUSY]))
+
+        # Same overlap rule as OBKProvisioning_WriteRecords()
+        spans = sorted((a, a + len(p)) for a, p in records.items())
+        if len(spans) != nb_files or any(spans[i][1] > spans[i + 1][0] for i in range(len(spans) - 1)):
+            self.reply(OBK_STREAM_NACK)
+            return False
+
+        self.provisioned.update(records)
+        self.reply(OBK_STREAM_ACK, "OBK stream done : %d file(s)" % nb_files)
+        return True
+
+
+def open_device(baud=0):
+    """Return (device, slave path) on a fresh pseudo terminal."""
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    return Device(master, baud), os.ttyname(slave)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--baud", type=int, default=0, help="emulate the UART line rate (0: as fast as the pty)")
+    args = parser.parse_args()
+
+    device, path = open_device(args.baud)
+    print(f"OBK loopback device on {path}")
+    sys.stdout.flush()
+    try:
+        while True:
+            device.session()
+    except (EOFError, OSError, KeyboardInterrupt):
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+"""Stream one or more .obk files to the secure firmware over the UART.
+
+Select "Receive .obk files over UART" (u) in the device menu, then run:
+
+    python3 obk_send.py --port /dev/ttyACM0 DA_Config.obk [other.obk ...]
+
+With --loopback the files are sent to the obk_loopback.py stand-in running
+on a pseudo terminal, which allows checking and timing the path on Linux.
+"""
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import threading
+import time
+import tty
+
+from obk_loopback import OBK_STREAM_ACK, OBK_STREAM_BUSY, OBK_STREAM_MAGIC, OBK_STREAM_NACK, open_device
+
+BAUDRATES = {9600: termios.B9600, 57600: termios.B57600, 115200: termios.B115200,
+             230400: termios.B230400, 460800: termios.B460800, 921600: termios.B921600}
+
+
+class Port:
+    def __init__(self, path, baud, timeout):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = BAUDRATES[baud]
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.timeout = timeout
+
+    def write(self, data):
+        os.write(self.fd, data)
+        termios.tcdrain(self.fd)
+
+    def wait_ack(self):
+        """Skip console traces until the ACK/NACK byte, echoing them.
+
+        BUSY is sent while the device writes the OBK, it restarts the timeout.
+        """
+        deadline = time.monotonic() + self.timeout
+        trace = b""
+        while True:
+            # The raw port blocks until a byte arrives, never past the deadline
+            remaining = deadline - time.monotonic()
+            if remaining <= 0 or not select.select([self.fd], [], [], remaining)[0]:
+                break
+            byte = os.read(self.fd, 1)
+            if not byte:
+                break
+            if byte[0] == OBK_STREAM_BUSY:
+                deadline = time.monotonic() + self.timeout
+                continue
+            if byte[0] in (OBK_STREAM_ACK, OBK_STREAM_NACK):
+                if trace.strip():
+                    print("  device: " + trace.decode(errors="replace").strip())
+                return byte[0] == OBK_STREAM_ACK
+            trace += byte
+        raise TimeoutError("no answer from device")
+
+    def close(self):
+        os.close(self.fd)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < 12:
+        raise ValueError(f"{path}: too short for an .obk file")
+    addr, length, encrypted = struct.unpack("<III", data[:12])
+    if len(data) != 12 + length:
+        raise ValueError(f"{path}: header length 0x{length:x} does not match file size")
+    return data[:12], data[12:]
+
+
+def send(port, files):
+    records = [load(f) for f in files]
+    start = time.monotonic()
+
+    port.write(struct.pack("<II", OBK_STREAM_MAGIC, len(records)))
+    if not port.wait_ack():
+        raise RuntimeError("session refused")
+
+    for name, (header, payload) in zip(files, records):
+        port.write(header)
+        if not port.wait_ack():
+            raise RuntimeError(f"{name}: header refused")
+        port.write(payload)
+        if not port.wait_ack():
+            raise RuntimeError(f"{name}: payload integrity check failed")
+        print(f"{name}: {len(payload)} bytes sent")
+
+    if not port.wait_ack():
+        raise RuntimeError("OBK programming failed")
+    elapsed = time.monotonic() - start
+    total = sum(12 + len(p) for _, p in records)
+    print(f"Provisioned {len(records)} file(s), {total} bytes in {elapsed * 1000:.1f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("files", nargs="+", help=".obk files to provision")
+    parser.add_argument("--port", help="serial port of the board (Virtual COM Port)")
+    parser.add_argument("--baud", type=int, default=115200, choices=sorted(BAUDRATES))
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for each answer")
+    parser.add_argument("--loopback", action="store_true", help="send to the obk_loopback.py stand-in")
+    args = parser.parse_args()
+
+    if args.loopback:
+        device, path = open_device(args.baud)
+        threading.Thread(target=device.session, daemon=True).start()
+    elif args.port:
+        path = args.port
+    else:
+        parser.error("--port or --loopback is required")
+
+    port = Port(path, args.baud, args.timeout)
+    try:
+        send(port, args.files)
+    except (RuntimeError, TimeoutError, ValueError) as e:
+        print(f"Error: {e}")
+        sys.exit(1)
+    finally:
+        port.close()
+
+
+if __name__ == "__main__":
+    main()